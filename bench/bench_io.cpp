@@ -0,0 +1,282 @@
+// google benchmark suite over the write, read and codec hot paths, see README for the build line
+#include <benchmark/benchmark.h>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include "gen.h"
+#include "../writer.h"
+#include "../reader.h"
+#include "../block_codec.h"
+#include "../block_writer.h"
+#include "../block_reader.h"
+
+namespace {
+
+std::string bench_dir() {
+    const char* d = std::getenv("HFT_BENCH_DIR");
+    return d ? d : "/tmp/hft_bench";
+}
+
+void report(benchmark::State& state, uint64_t rows, uint64_t bytes) {
+    state.counters["rows/s"] = benchmark::Counter(static_cast<double>(rows), benchmark::Counter::kIsIterationInvariantRate);
+    // inverted rate, printed as time per row
+    state.counters["t/row"] = benchmark::Counter(static_cast<double>(rows),
+                                                 benchmark::Counter::kIsIterationInvariantRate |
+                                                 benchmark::Counter::kInvert);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+}
+
+constexpr uint64_t L2_ROW_BYTES = 8 + 4 + 4 + 1;
+constexpr uint64_t L3_ROW_BYTES = 8 + 8 + 4 + 4 + 1 + 1;
+
+// one l2 day on disk shared by the reader benchmarks, written once per rows count
+const ReaderOpt& l2_day(size_t rows) {
+    static std::vector<std::pair<size_t, ReaderOpt>> days;
+    for (auto& d : days) {
+        if (d.first == rows) {
+            return d.second;
+        }
+    }
+    const std::string product = "L2R" + std::to_string(rows);
+    std::filesystem::remove_all(bench_dir() + "/" + product);
+    {
+        WriterT<L2Schema> w(WriterOpt(bench_dir(), product));
+        w.start();
+        for (const L2Row& r : FeedGen(GenOpt{}).l2(rows)) {
+            while (!w.enqueue(r)) {
+            }
+        }
+        w.stop();
+        w.join();
+    }
+    ReaderOpt ro;
+    ro.base_dir = bench_dir();
+    ro.product = product;
+    days.emplace_back(rows, ro);
+    return days.back().second;
+}
+
+template <class Seg>
+uint64_t touch(const Seg& s) {
+    const auto* px = s.template col<uint32_t>(L2Schema::COL_PX);
+    const auto* qty = s.template col<float>(L2Schema::COL_QTY);
+    uint64_t acc = 0;
+    for (uint64_t i = 0; i < s.rows; ++i) {
+        acc += px[i] + static_cast<uint64_t>(qty[i]);
+    }
+    return acc;
+}
+
+// enqueue -> writer thread -> mmapped columns -> close, per iteration a fresh day file
+void BM_WriterPersist(benchmark::State& state) {
+    const size_t rows = static_cast<size_t>(state.range(0));
+    const std::vector<L2Row> data = FeedGen(GenOpt{}).l2(rows);
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::filesystem::remove_all(bench_dir() + "/L2W");
+        state.ResumeTiming();
+        WriterT<L2Schema> w(WriterOpt(bench_dir(), "L2W"));
+        w.start();
+        for (const L2Row& r : data) {
+            while (!w.enqueue(r)) {
+            }
+        }
+        w.stop();
+        w.join();
+    }
+    report(state, rows, rows * L2_ROW_BYTES);
+}
+
+void BM_ReaderMapped(benchmark::State& state) {
+    const size_t rows = static_cast<size_t>(state.range(0));
+    ReaderT<L2Schema> reader(l2_day(rows));
+    for (auto _ : state) {
+        reader.visit_single_segment(reader.paths()[0], [&](const auto& seg) { benchmark::DoNotOptimize(touch(seg)); });
+    }
+    report(state, rows, rows * L2_ROW_BYTES);
+}
+
+// mapped segment walked by for_each_row_batch, arg 1 = prefetch distance in batches, -1 = tuned
+void BM_ReaderMappedBatched(benchmark::State& state) {
+    const size_t rows = static_cast<size_t>(state.range(0));
+    ReaderT<L2Schema> reader(l2_day(rows));
+    RowBatchOpt opt;
+    reader.visit_single_segment(reader.paths()[0], [&](const auto& seg) {
+        opt = ReaderT<L2Schema>::tune_row_batch(seg);
+    });
+    if (opt.prefetch_rows == RowBatchOpt::AUTO) {
+        opt.prefetch_rows = 0; // day too small to time
+    }
+    if (state.range(1) >= 0) {
+        opt.prefetch_rows = static_cast<uint32_t>(state.range(1)) * opt.batch_rows;
+    }
+    for (auto _ : state) {
+        reader.visit_single_segment(reader.paths()[0], [&](const auto& seg) {
+            ReaderT<L2Schema>::for_each_row_batch(seg, opt, [&](const auto& b) { benchmark::DoNotOptimize(touch(b)); });
+        });
+    }
+    report(state, rows, rows * L2_ROW_BYTES);
+    state.counters["prefetch_rows"] = opt.prefetch_rows;
+}
+
+// includes the copy into the HugeBuff stage, the difference to BM_ReaderMapped is the staging cost
+void BM_ReaderStaged(benchmark::State& state) {
+    const size_t rows = static_cast<size_t>(state.range(0));
+    ReaderT<L2Schema> reader(l2_day(rows));
+    for (auto _ : state) {
+        reader.visit_stage_files([&](const auto& seg) {
+            benchmark::DoNotOptimize(touch(seg));
+            return true;
+        });
+    }
+    report(state, rows, rows * L2_ROW_BYTES);
+}
+
+// staging through StageCopier, arg 1 = threads, arg 2 = 1 for non temporal stores. GB/s is the copier's own figure
+void BM_ReaderStagedCopier(benchmark::State& state) {
+    const size_t rows = static_cast<size_t>(state.range(0));
+    ReaderOpt ro = l2_day(rows);
+    ro.stage_threads = static_cast<uint32_t>(state.range(1));
+    ro.stage_stream_bytes = state.range(2) ? 0 : ~size_t{0};
+    ReaderT<L2Schema> reader(ro);
+    for (auto _ : state) {
+        reader.visit_stage_files([&](const auto& seg) {
+            benchmark::DoNotOptimize(touch(seg));
+            return true;
+        });
+    }
+    report(state, rows, rows * L2_ROW_BYTES);
+    state.counters["stage_GB/s"] = reader.stage_copier().stats().gbps();
+}
+
+// one block with prices spread over 2^bw ticks, so the price column packs at about bw bits
+std::vector<L2Row> l2t_block(int bw, size_t n) {
+    std::vector<L2Row> out = FeedGen(GenOpt{}).l2(n);
+    std::mt19937_64 rng(bw);
+    const uint32_t spread = bw >= 32 ? ~0u : (1u << bw) - 1;
+    for (L2Row& r : out) {
+        r.price = 100'000 + static_cast<uint32_t>(rng() & spread);
+    }
+    return out;
+}
+
+void BM_L2TEncode(benchmark::State& state) {
+    const size_t n = 8192;
+    const auto rows = l2t_block(static_cast<int>(state.range(0)), n);
+    std::vector<uint8_t> out;
+    for (auto _ : state) {
+        out.clear();
+        L2TBlockCodec<L2Schema>::encode_block(rows.data(), static_cast<uint32_t>(n), out);
+        benchmark::DoNotOptimize(out.data());
+    }
+    report(state, n, n * L2_ROW_BYTES);
+    state.counters["ratio"] = static_cast<double>(n * L2_ROW_BYTES) / static_cast<double>(out.size());
+}
+
+void BM_L2TDecode(benchmark::State& state) {
+    const size_t n = 8192;
+    const auto rows = l2t_block(static_cast<int>(state.range(0)), n);
+    std::vector<uint8_t> enc;
+    L2TBlockCodec<L2Schema>::encode_block(rows.data(), static_cast<uint32_t>(n), enc);
+    std::vector<L2Row> out;
+    for (auto _ : state) {
+        out.clear();
+        L2TBlockCodec<L2Schema>::decode_block(enc.data(), enc.size(), out);
+        benchmark::DoNotOptimize(out.data());
+    }
+    report(state, n, n * L2_ROW_BYTES);
+    state.counters["ratio"] = static_cast<double>(n * L2_ROW_BYTES) / static_cast<double>(enc.size());
+}
+
+// l2 and l3 block files, Feed supplies the rows, the writer/reader pair and the product name
+struct L2Blocks {
+    using Writer = L2BlockWriter;
+    using Reader = L2BlockReader;
+    static constexpr const char* NAME = "L2";
+    static constexpr uint64_t ROW_BYTES = L2_ROW_BYTES;
+    static std::vector<L2Row> rows(size_t n) { return FeedGen(GenOpt{}).l2(n); }
+};
+
+struct L3Blocks {
+    using Writer = L3BlockWriter;
+    using Reader = L3BlockReader;
+    static constexpr const char* NAME = "L3";
+    static constexpr uint64_t ROW_BYTES = L3_ROW_BYTES;
+    static std::vector<L3Row> rows(size_t n) { return FeedGen(GenOpt{}).l3(n); }
+};
+
+template <class Feed>
+void BM_BlockWrite(benchmark::State& state) {
+    const size_t rows = static_cast<size_t>(state.range(0));
+    const auto data = Feed::rows(rows);
+    const std::string product = std::string(Feed::NAME) + "W";
+    uint64_t file_bytes = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::filesystem::remove_all(bench_dir() + "/" + product + "-BLOCKS");
+        state.ResumeTiming();
+        typename Feed::Writer w(BlockWriterOpt(bench_dir(), product));
+        w.begin_day(20240102);
+        for (const auto& r : data) {
+            w.write_row(r);
+        }
+        w.close();
+    }
+    file_bytes = std::filesystem::file_size(bench_dir() + "/" + product + "-BLOCKS/20240102.blocks");
+    report(state, rows, rows * Feed::ROW_BYTES);
+    state.counters["ratio"] = static_cast<double>(rows * Feed::ROW_BYTES) / static_cast<double>(file_bytes);
+}
+
+template <class Feed>
+void BM_BlockRead(benchmark::State& state) {
+    const size_t rows = static_cast<size_t>(state.range(0));
+    const std::string product = std::string(Feed::NAME) + "R";
+    {
+        std::filesystem::remove_all(bench_dir() + "/" + product + "-BLOCKS");
+        typename Feed::Writer w(BlockWriterOpt(bench_dir(), product));
+        w.begin_day(20240102);
+        for (const auto& r : Feed::rows(rows)) {
+            w.write_row(r);
+        }
+        w.close();
+    }
+    BlockReaderOpt ro;
+    ro.base_dir = bench_dir();
+    ro.product = product;
+    ro.verify = static_cast<VerifyMode>(state.range(1));
+    for (auto _ : state) {
+        typename Feed::Reader reader(ro);
+        uint64_t n = 0;
+        reader.visit_day_files([&](const auto& v) { n += v.n_rows; });
+        benchmark::DoNotOptimize(n);
+    }
+    report(state, rows, rows * Feed::ROW_BYTES);
+}
+
+} // namespace
+
+BENCHMARK(BM_WriterPersist)->Arg(1 << 20)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_ReaderMapped)->Arg(1 << 20)->Arg(1 << 23)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ReaderMappedBatched)
+    ->ArgsProduct({{1 << 23}, {-1, 0, 2, 8}})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ReaderStaged)->Arg(1 << 20)->Arg(1 << 23)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ReaderStagedCopier)
+    ->ArgsProduct({{1 << 23}, {1, 2, 4}, {0, 1}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(BM_L2TEncode)->DenseRange(4, 28, 4);
+BENCHMARK(BM_L2TDecode)->DenseRange(4, 28, 4);
+BENCHMARK_TEMPLATE(BM_BlockWrite, L2Blocks)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_BlockRead, L2Blocks)
+    ->Args({1 << 20, static_cast<int>(VerifyMode::OFF)})
+    ->Args({1 << 20, static_cast<int>(VerifyMode::ALWAYS)})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_BlockWrite, L3Blocks)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_BlockRead, L3Blocks)
+    ->Args({1 << 20, static_cast<int>(VerifyMode::OFF)})
+    ->Args({1 << 20, static_cast<int>(VerifyMode::ALWAYS)})
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
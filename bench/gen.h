@@ -0,0 +1,107 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include "../schemas.h"
+
+// synthetic but shaped like a real feed: exponential inter arrivals with bursts, a random walk mid,
+// a spread of levels around it and skewed sizes. seeded, so every run sees the same data
+struct GenOpt {
+    uint64_t start_ts{1704204000ull * 1'000'000'000ull}; // 2024-01-02 14:00 utc
+    double mean_gap_ns{20'000.0}; // between events outside bursts
+    double burst_prob{0.02}; // chance an event starts a burst
+    uint32_t burst_len{64}; // events per burst
+    double burst_gap_ns{200.0};
+    double walk_sigma{0.3}; // mid move per event, in ticks
+    uint32_t levels{10}; // events land within this many ticks of the touch
+    uint32_t start_px{450'000};
+    double mean_qty{5.0};
+    uint64_t seed{42};
+};
+
+class FeedGen {
+public:
+    explicit FeedGen(const GenOpt& opt) : opt_(opt), rng_(opt.seed), mid_(opt.start_px), ts_(opt.start_ts) {
+    }
+
+    std::vector<L2Row> l2(size_t n) {
+        std::vector<L2Row> out(n);
+        for (L2Row& r : out) {
+            step();
+            r.ts_ns = ts_;
+            r.side = static_cast<uint8_t>(coin(rng_));
+            r.price = level_px(r.side);
+            r.qty = qty();
+        }
+        return out;
+    }
+
+    // adds (60%), cancels (30%) and fills (10%) against the live order set
+    std::vector<L3Row> l3(size_t n) {
+        std::vector<L3Row> out(n);
+        for (L3Row& r : out) {
+            step();
+            r.ts_ns = ts_;
+            const double u = unit(rng_);
+            if (live_.empty() || u < 0.6) {
+                r.id = next_id_++;
+                r.side = static_cast<uint8_t>(coin(rng_));
+                r.price = level_px(r.side);
+                r.size = std::max(1u, static_cast<uint32_t>(qty()));
+                r.action = 0;
+                live_.push_back(Live{r.id, r.price, r.size, r.side});
+                continue;
+            }
+            const size_t k = std::uniform_int_distribution<size_t>(0, live_.size() - 1)(rng_);
+            const Live o = live_[k];
+            r.id = o.id;
+            r.price = o.px;
+            r.side = o.side;
+            r.size = o.sz;
+            r.action = u < 0.9 ? 1 : 3;
+            live_[k] = live_.back();
+            live_.pop_back();
+        }
+        return out;
+    }
+
+private:
+    struct Live {
+        uint64_t id;
+        uint32_t px;
+        uint32_t sz;
+        uint8_t side;
+    };
+
+    void step() {
+        if (burst_left_ == 0 && unit(rng_) < opt_.burst_prob) {
+            burst_left_ = opt_.burst_len;
+        }
+        const double mean = burst_left_ ? opt_.burst_gap_ns : opt_.mean_gap_ns;
+        if (burst_left_) {
+            --burst_left_;
+        }
+        ts_ += 1 + static_cast<uint64_t>(std::exponential_distribution<double>(1.0 / mean)(rng_));
+        mid_ += std::normal_distribution<double>(0.0, opt_.walk_sigma)(rng_);
+    }
+
+    uint32_t level_px(uint8_t side) {
+        const uint32_t m = static_cast<uint32_t>(std::llround(mid_));
+        const uint32_t off = 1 + std::uniform_int_distribution<uint32_t>(0, opt_.levels - 1)(rng_);
+        return side ? m - off : m + off;
+    }
+
+    float qty() { return static_cast<float>(std::ceil(std::exponential_distribution<double>(1.0 / opt_.mean_qty)(rng_))); }
+
+    GenOpt opt_;
+    std::mt19937_64 rng_;
+    std::uniform_int_distribution<int> coin{0, 1};
+    std::uniform_real_distribution<double> unit{0.0, 1.0};
+    double mid_;
+    uint64_t ts_;
+    uint32_t burst_left_{0};
+    uint64_t next_id_{1};
+    std::vector<Live> live_;
+};
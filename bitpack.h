@@ -0,0 +1,170 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct BitPack {
+    static inline uint64_t ceil_log2_u64(uint64_t x) {
+        if (x <= 1) {
+            return 1;
+        }
+        return 64u - static_cast<uint32_t>(__builtin_clzll(x - 1));
+    }
+
+    static inline uint32_t zigzag_enc32(int32_t v) {
+        return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31);
+    }
+
+    static inline int32_t zigzag_dec32(uint32_t v) {
+        return int32_t((v >> 1) ^ -(v & 1));
+    }
+
+    static inline uint64_t zigzag_enc64(int64_t v) {
+        return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+    }
+
+    static inline int64_t zigzag_dec64(uint64_t v) {
+        return int64_t((v >> 1) ^ -(v & 1));
+    }
+
+    static inline void bitpack_u32(const uint32_t* vals, size_t n, uint32_t bw, std::vector<uint8_t>& out) {
+        if (bw == 0 || n == 0) {
+            return;
+        }
+
+        const uint64_t mask = bw == 32 ? 0xffff'ffffull : (1ull << bw) - 1ull;
+        uint64_t acc = 0;
+        uint32_t bits = 0;
+        for (size_t i = 0; i < n; ++i) {
+            const uint64_t v = vals[i] & mask;
+            acc |= (v << bits);
+            bits += bw;
+            while (bits >= 8) {
+                out.push_back(static_cast<uint8_t>(acc & 0xffu));
+                acc >>= 8;
+                bits -= 8;
+            }
+        }
+
+        if (bits > 0) {
+            out.push_back(static_cast<uint8_t>(acc & 0xffu));
+        }
+    }
+
+
+    static inline void bitpack_u64(const uint64_t* vals, size_t n, uint32_t bw, std::vector<uint8_t>& out) {
+        if (bw == 0 || n == 0) {
+            return;
+        }
+
+        const uint64_t mask = (bw == 64) ? ~0ull : (1ull << bw) - 1ull;
+        uint64_t acc = 0;
+        uint64_t bits = 0;
+        for (size_t i = 0; i < n; ++i) {
+            const uint64_t v = vals[i] & mask;
+            acc |= (v << bits);
+            bits += bw;
+            while (bits >= 8) {
+                out.push_back(static_cast<uint8_t>(acc & 0xffu));
+                acc >>= 8;
+                bits -= 8;
+            }
+        }
+        if (bits > 0) {
+            out.push_back(static_cast<uint8_t>(acc & 0xffu));
+        }
+    }
+
+    static void bitunpack_u64(const uint8_t* src, size_t n, uint32_t bw, uint64_t* out) {
+        if (bw == 0 || n == 0) {
+            for (size_t i = 0; i < n; ++i) {
+                out[i] = 0;
+            }
+            return;
+        }
+
+        const uint64_t mask = (bw == 64) ? ~0ull : (1ull << bw) - 1ull;
+        size_t idx = 0;
+        uint64_t acc = 0;
+        uint32_t bits = 0;
+        for (size_t i = 0; i < n; ++i) {
+            while (bits < bw) {
+                acc |= (static_cast<uint64_t>(src[idx++]) << bits);
+                bits += 8;
+            }
+            out[i] = acc & mask;
+            acc >>= bw;
+            bits -= bw;
+        }
+    }
+
+    static void bitunpack_u32(const uint8_t* src, size_t n, uint32_t bw, uint32_t* out) {
+        if (bw == 0 || n == 0) {
+            for (size_t i = 0; i < n; ++i) {
+                out[i] = 0;
+            }
+            return;
+        }
+
+        const uint64_t mask = (bw == 32) ? 0xffff'ffffull : (1ull << bw) - 1ull;
+        size_t idx = 0;
+        uint64_t acc = 0;
+        uint32_t bits = 0;
+        for (size_t i = 0; i < n; ++i) {
+            while (bits < bw) {
+                acc |= (static_cast<uint64_t>(src[idx++]) << bits);
+                bits += 8;
+            }
+            out[i] = static_cast<uint32_t>(acc & mask);
+            acc >>= bw;
+            bits -= bw;
+        }
+    }
+
+    static void bitpack_u8(const uint8_t* src, size_t n, std::vector<uint8_t>& out) {
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            uint8_t b =
+                (src[i + 0] & 1) << 0 |
+                (src[i + 1] & 1) << 1 |
+                (src[i + 2] & 1) << 2 |
+                (src[i + 3] & 1) << 3 |
+                (src[i + 4] & 1) << 4 |
+                (src[i + 5] & 1) << 5 |
+                (src[i + 6] & 1) << 6 |
+                (src[i + 7] & 1) << 7;
+            out.push_back(b);
+        }
+        if (i < n) {
+            uint8_t b = 0;
+            uint32_t bit = 0;
+            for (; i < n; ++i, ++bit) {
+                b |= (src[i] & 1) << bit;
+            }
+            out.push_back(b);
+        }
+    }
+
+    static void bitunpack_u8(const uint8_t* src, size_t n, uint8_t* out) {
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            uint8_t b = *src++;
+            out[i + 0] = b >> 0 & 1;
+            out[i + 1] = b >> 1 & 1;
+            out[i + 2] = b >> 2 & 1;
+            out[i + 3] = b >> 3 & 1;
+            out[i + 4] = b >> 4 & 1;
+            out[i + 5] = b >> 5 & 1;
+            out[i + 6] = b >> 6 & 1;
+            out[i + 7] = b >> 7 & 1;
+        }
+
+        if (i < n) {
+            const uint8_t b = *src;
+            uint32_t bit = 0;
+            for (; i < n; ++i, ++bit) {
+                out[i] = b >> bit & 1;
+            }
+        }
+    }
+};
@@ -6,9 +6,19 @@
 #include <limits>
 #include <stdexcept>
 #include <type_traits>
-
+#include "schemas.h"
+#include "bitpack.h"
+#include "col_codec.h"
+#include "float_codec.h"
+#include "block_format.h"
+
+// l2 rows with a float size and optionally an 'L'/'T' type. L2Row names the size qty and has no type column,
+// its rows are stored as all levels and the type column encodes to CONST. timestamps are kept at ts_scale_ns (1 ms)
 template <class Schema>
-struct L2TBlockCodec {
+struct L2TBlockCodec : BitPack {
+    static constexpr char MAGIC[8] = {'L', '2', 'T', 'B', 'L', 'K', '\n', '\0'};
+    static constexpr uint16_t VERSION = 3;
+
 #pragma pack(push, 1)
     struct BlockHeader {
         char magic[8];
@@ -16,11 +26,14 @@ struct L2TBlockCodec {
         uint16_t flags;
         uint32_t n_rows;
         uint64_t base_ts;
-        uint32_t base_px;
         uint32_t ts_scale_ns = 1'000'000;
-        uint8_t ts_bw;
-        uint8_t px_bw;
-        uint16_t reserved0;
+        // encoding tag per column, picked per block
+        uint8_t ts_enc; // ColEnc
+        uint8_t px_enc; // ColEnc
+        uint8_t sz_enc; // FloatEnc
+        uint8_t side_enc; // ColEnc
+        uint8_t type_enc; // ColEnc
+        uint8_t reserved0[3];
         uint32_t off_ts;
         uint32_t len_ts;
         uint32_t off_px;
@@ -34,210 +47,90 @@ struct L2TBlockCodec {
     };
 #pragma pack(pop)
 
-    static inline uint64_t ceil_log2_u64(uint64_t x) {
-        if (x <= 1) {
-            return 1;
-        }
-        return 64u - static_cast<uint32_t>(__builtin_clzll(x - 1));
-    }
-
-    static inline uint32_t zigzag_enc32(int32_t v) {
-        return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31);
-    }
-
-    static inline int32_t zigzag_dec32(uint32_t v) {
-        return int32_t((v >> 1) ^ -(v & 1));
-    }
-
-    static inline void bitpack_u32(const uint32_t* vals, size_t n, uint32_t bw, std::vector<uint8_t>& out) {
-        if (bw == 0 || n == 0) {
-            return;
-        }
-
-        const uint64_t mask = bw == 32 ? 0xffff'ffffull : (1ull << bw) - 1ull;
-        uint64_t acc = 0;
-        uint32_t bits = 0;
-        for (size_t i = 0; i < n; ++i) {
-            const uint64_t v = vals[i] & mask;
-            acc |= (v << bits);
-            bits += bw;
-            while (bits >= 8) {
-                out.push_back(static_cast<uint8_t>(acc & 0xffu));
-                acc >>= 8;
-                bits -= 8;
-            }
-        }
-
-        if (bits > 0) {
-            out.push_back(static_cast<uint8_t>(acc & 0xffu));
-        }
-    }
+    using Row = typename Schema::Row;
 
+    static constexpr bool HAS_TYPE = requires(Row r) { r.type; };
 
-    static inline void bitpack_u64(const uint64_t* vals, size_t n, uint32_t bw, std::vector<uint8_t>& out) {
-        if (bw == 0 || n == 0) {
-            return;
-        }
-
-        const uint64_t mask = (bw == 64) ? ~0ull : (1ull << bw) - 1ull;
-        uint64_t acc = 0;
-        uint64_t bits = 0;
-        for (size_t i = 0; i < n; ++i) {
-            const uint64_t v = vals[i] & mask;
-            acc |= (v << bits);
-            bits += bw;
-            while (bits >= 8) {
-                out.push_back(static_cast<uint8_t>(acc & 0xffu));
-                acc >>= 8;
-                bits -= 8;
-            }
-        }
-        if (bits > 0) {
-            out.push_back(static_cast<uint8_t>(acc & 0xffu));
-        }
+    static inline bool check_magic(const BlockHeader& hdr) {
+        return std::memcmp(hdr.magic, MAGIC, sizeof(MAGIC)) == 0 && hdr.version == VERSION;
     }
 
-    static void bitunpack_u64(const uint8_t* src, size_t n, uint32_t bw, uint64_t* out) {
-        if (bw == 0 || n == 0) {
-            for (size_t i = 0; i < n; ++i) {
-                out[i] = 0;
-            }
-            return;
+    static inline float size_of(const Row& r) {
+        if constexpr (requires { r.size; }) {
+            return r.size;
         }
-
-        const uint64_t mask = (bw == 64) ? ~0ull : (1ull << bw) - 1ull;
-        size_t idx = 0;
-        uint64_t acc = 0;
-        uint32_t bits = 0;
-        for (size_t i = 0; i < n; ++i) {
-            while (bits < bw) {
-                acc |= (static_cast<uint64_t>(src[idx++]) << bits);
-                bits += 8;
-            }
-            out[i] = acc & mask;
-            acc >>= bw;
-            bits -= bw;
+        else {
+            return r.qty;
         }
     }
 
-    static void bitunpack_u32(const uint8_t* src, size_t n, uint32_t bw, uint32_t* out) {
-        if (bw == 0 || n == 0) {
-            for (size_t i = 0; i < n; ++i) {
-                out[i] = 0;
-            }
+    static inline void set_size(Row& r, float sz) {
+        if constexpr (requires { r.size; }) {
+            r.size = sz;
         }
-
-        const uint64_t mask = (bw == 32) ? 0xffff'ffffull : (1ull << bw) - 1ull;
-        size_t idx = 0;
-        uint64_t acc = 0;
-        uint32_t bits = 0;
-        for (size_t i = 0; i < n; ++i) {
-            while (bits < bw) {
-                acc |= (static_cast<uint64_t>(src[idx++]) << bits);
-                bits += 8;
-            }
-            out[i] = static_cast<uint32_t>(acc & mask);
-            acc >>= bw;
-            bits -= bw;
+        else {
+            r.qty = sz;
         }
     }
 
-    static void bitpack_u8(const uint8_t* src, size_t n, std::vector<uint8_t>& out) {
-        size_t i = 0;
-        for (; i + 8 <= n; i += 8) {
-            uint8_t b =
-                (src[i + 0] & 1) << 0 |
-                (src[i + 1] & 1) << 1 |
-                (src[i + 2] & 1) << 2 |
-                (src[i + 3] & 1) << 3 |
-                (src[i + 4] & 1) << 4 |
-                (src[i + 5] & 1) << 5 |
-                (src[i + 6] & 1) << 6 |
-                (src[i + 7] & 1) << 7;
-            out.push_back(b);
-        }
-        if (i < n) {
-            uint8_t b = 0;
-            uint32_t bit = 0;
-            for (; i < n; ++i, ++bit) {
-                b |= (src[i] & 1) << bit;
+    static void block_stats(const Row* rows, uint32_t n, BlockStats& st) {
+        st = BlockStats{};
+        st.min_ts = ~0ull;
+        st.min_px = ~0u;
+        for (uint32_t i = 0; i < n; ++i) {
+            const Row& r = rows[i];
+            st.min_ts = std::min(st.min_ts, r.ts_ns);
+            st.max_ts = std::max(st.max_ts, r.ts_ns);
+            st.min_px = std::min(st.min_px, r.price);
+            st.max_px = std::max(st.max_px, r.price);
+            st.n_side[r.side & 1]++;
+            if constexpr (HAS_TYPE) {
+                st.n_type[r.type == 'T' ? 1 : 0]++;
             }
-            out.push_back(b);
+            st.sum_size += size_of(r);
         }
-    }
-
-    static void bitunpack_u8(const uint8_t* src, size_t n, uint8_t* out) {
-        size_t i = 0;
-        for (; i + 8 <= n; i += 8) {
-            uint8_t b = *src++;
-            out[i + 0] = b >> 0 & 1;
-            out[i + 1] = b >> 1 & 1;
-            out[i + 2] = b >> 2 & 1;
-            out[i + 3] = b >> 3 & 1;
-            out[i + 4] = b >> 4 & 1;
-            out[i + 5] = b >> 5 & 1;
-            out[i + 6] = b >> 6 & 1;
-            out[i + 7] = b >> 7 & 1;
-        }
-
-        if (i < n) {
-            const uint8_t b = *src;
-            uint32_t bit = 0;
-            for (; i < n; ++i, ++bit) {
-                out[i] = b >> bit & 1;
-            }
+        if (n > 0) {
+            st.first_ts = rows[0].ts_ns;
+            st.last_ts = rows[n - 1].ts_ns;
+            st.first_px = rows[0].price;
+            st.last_px = rows[n - 1].price;
         }
     }
 
-    using Row = typename Schema::Row;
-
     static void encode_block(const Row* rows, uint32_t n, std::vector<uint8_t>& out) {
         if (n == 0) {
             return;
         }
 
         BlockHeader hdr{};
-        hdr.version = 1;
+        std::memcpy(hdr.magic, MAGIC, sizeof(MAGIC));
+        hdr.version = VERSION;
         hdr.flags = 0;
         hdr.n_rows = n;
         hdr.base_ts = rows[0].ts_ns;
-        hdr.base_px = rows[0].price;
 
         std::vector<uint64_t> ts_delta(n);
-        std::vector<uint32_t> px_delta_zigzag(n);
-        std::vector<uint8_t> side(n);
-        std::vector<uint8_t> type(n);
-
-        uint64_t max_dt = 0;
-        uint64_t max_dxz = 0;
-
+        std::vector<uint64_t> px(n);
+        std::vector<float> sz(n);
+        std::vector<uint64_t> side(n);
+        std::vector<uint64_t> type(n);
 
         for (uint32_t i = 0; i < n; ++i) {
             const uint64_t dt = rows[i].ts_ns - hdr.base_ts;
             // apply scale
-            const uint32_t u = dt / hdr.ts_scale_ns;
-            ts_delta[i] = u;
-            if (u > max_dt) {
-                max_dt = u;
-            }
-
-            const int32_t dx = static_cast<int32_t>(static_cast<int64_t>(rows[i].price - static_cast<int64_t>(hdr.
-                base_px)));
-            const uint32_t dz = zigzag_enc32(dx);
-            px_delta_zigzag[i] = dz;
-            if (dz > max_dxz) {
-                max_dxz = dz;
-            }
-
+            ts_delta[i] = dt / hdr.ts_scale_ns;
+            px[i] = rows[i].price;
+            sz[i] = size_of(rows[i]);
             side[i] = rows[i].side;
             // encode chars as L = 0, T = 1
-            type[i] = rows[i].type == 'T' ? 1 : 0;
+            if constexpr (HAS_TYPE) {
+                type[i] = rows[i].type == 'T' ? 1 : 0;
+            }
+            else {
+                type[i] = 0;
+            }
         }
 
-        hdr.ts_bw = static_cast<uint8_t>(ceil_log2_u64(max_dt + 1));
-        hdr.px_bw = static_cast<uint8_t>(ceil_log2_u64(max_dxz + 1));
-        hdr.reserved0 = 0;
-
         const uint32_t start = static_cast<uint32_t>(out.size());
         const uint32_t hdr_size = (sizeof(BlockHeader));
         out.resize(start + hdr_size);
@@ -246,34 +139,31 @@ struct L2TBlockCodec {
         {
             // original size of vector
             const size_t before = out.size();
-            // store packed data
-            bitpack_u64(ts_delta.data(), n, hdr.ts_bw, out);
-            // len of packed data is new size - before
+            // store encoded data, the codec picks FOR/delta/RLE/dict/const/raw per block
+            hdr.ts_enc = static_cast<uint8_t>(ColCodec::encode(ts_delta.data(), n, sizeof(uint64_t), out));
+            // len of encoded data is new size - before
             hdr.len_ts = (out.size() - before);
         }
 
         hdr.off_px = hdr.off_ts + hdr.len_ts;
         {
             const size_t before = out.size();
-            bitpack_u32(px_delta_zigzag.data(), n, hdr.px_bw, out);
+            hdr.px_enc = static_cast<uint8_t>(ColCodec::encode(px.data(), n, sizeof(uint32_t), out));
             hdr.len_px = (out.size() - before);
         }
 
         hdr.off_sz = hdr.off_px + hdr.len_px;
-        hdr.len_sz = n * static_cast<uint32_t>(sizeof(float));
         {
+            // picks gorilla/byte shuffle/decimal lots per block, whichever is smallest
             const size_t before = out.size();
-            out.resize(before + hdr.len_sz);
-            uint8_t* p = out.data() + before;
-            for (uint32_t i = 0; i < n; ++i) {
-                std::memcpy(p + i * sizeof(float), &rows[i].size, sizeof(float));
-            }
+            hdr.sz_enc = static_cast<uint8_t>(FloatCodec::encode(sz.data(), n, out));
+            hdr.len_sz = (out.size() - before);
         }
 
         hdr.off_side = hdr.off_sz + hdr.len_sz;
         {
             size_t before = out.size();
-            bitpack_u8(side.data(), n, out);
+            hdr.side_enc = static_cast<uint8_t>(ColCodec::encode(side.data(), n, sizeof(uint8_t), out));
             hdr.len_side = out.size() - before;
         }
 
@@ -281,14 +171,16 @@ struct L2TBlockCodec {
         hdr.off_type = hdr.off_side + hdr.len_side;
         {
             size_t before = out.size();
-            bitpack_u8(type.data(), n, out);
+            hdr.type_enc = static_cast<uint8_t>(ColCodec::encode(type.data(), n, sizeof(uint8_t), out));
             hdr.len_type = out.size() - before;
         }
 
         std::memcpy(out.data() + start, &hdr, sizeof(BlockHeader));
     }
 
-    static size_t decode_block(const uint8_t* src, size_t src_len, std::vector<Row>& rows_out) {
+    // expect_rows is the row count from the block index, 0 when the block was found without one
+    static size_t decode_block(const uint8_t* src, size_t src_len, std::vector<Row>& rows_out,
+                               uint32_t expect_rows = 0) {
         if (src_len < sizeof(BlockHeader)) {
             throw std::runtime_error("block too small");
         }
@@ -298,67 +190,427 @@ struct L2TBlockCodec {
         if (!check_magic(hdr)) {
             throw std::runtime_error("block magic incorrect");
         }
+        if (!block_rows_ok(hdr.n_rows, expect_rows)) {
+            throw std::runtime_error("block row count corrupt");
+        }
 
         if (hdr.n_rows == 0) {
             return sizeof(BlockHeader);
         }
 
-        rows_out.resize(hdr.n_rows);
+        const uint32_t offs[5] = {hdr.off_ts, hdr.off_px, hdr.off_sz, hdr.off_side, hdr.off_type};
+        const uint32_t lens[5] = {hdr.len_ts, hdr.len_px, hdr.len_sz, hdr.len_side, hdr.len_type};
+        size_t end_off = sizeof(BlockHeader);
+        for (uint32_t c = 0; c < 5; ++c) {
+            if (!span_ok(offs[c], lens[c], src_len)) {
+                throw std::runtime_error("block truncated");
+            }
+            end_off = std::max<size_t>(end_off, static_cast<size_t>(offs[c]) + lens[c]);
+        }
+
+        const uint32_t n = hdr.n_rows;
+        rows_out.resize(n);
+
+        std::vector<uint64_t> ts_delta(n);
+        ColCodec::decode(static_cast<ColEnc>(hdr.ts_enc), src + hdr.off_ts, hdr.len_ts, n, sizeof(uint64_t),
+                         ts_delta.data());
+
+        // delta encoded prices are rebuilt with a simd prefix sum
+        std::vector<uint32_t> px(n);
+        ColCodec::decode_u32(static_cast<ColEnc>(hdr.px_enc), src + hdr.off_px, hdr.len_px, n, px.data());
+
+        std::vector<float> sz(n);
+        FloatCodec::decode(static_cast<FloatEnc>(hdr.sz_enc), src + hdr.off_sz, hdr.len_sz, n, sz.data());
+
+        std::vector<uint64_t> side(n);
+        ColCodec::decode(static_cast<ColEnc>(hdr.side_enc), src + hdr.off_side, hdr.len_side, n, sizeof(uint8_t),
+                         side.data());
+
+        std::vector<uint64_t> type(n);
+        ColCodec::decode(static_cast<ColEnc>(hdr.type_enc), src + hdr.off_type, hdr.len_type, n, sizeof(uint8_t),
+                         type.data());
 
-        std::vector<uint64_t> ts_delta(hdr.n_rows);
-        if (hdr.ts_bw == 0) {
-            fill(ts_delta.begin(), ts_delta.end(), 0);
+        for (uint32_t i = 0; i < n; ++i) {
+            Row& r = rows_out[i];
+            r.ts_ns = hdr.base_ts + ts_delta[i] * hdr.ts_scale_ns;
+            r.price = px[i];
+            set_size(r, sz[i]);
+            r.side = static_cast<uint8_t>(side[i]);
+            if constexpr (HAS_TYPE) {
+                if (type[i] == 1) {
+                    r.type = 'T';
+                } else {
+                    r.type = 'L';
+                }
+            }
         }
-        else {
-            bitunpack_u64(src + hdr.off_ts, hdr.n_rows, hdr.ts_bw, ts_delta.data());
+
+        return end_off;
+    }
+};
+
+// L3 rows (order id, ts, px, size, action, side), every column goes through ColCodec and keeps full ns timestamps
+template <class Schema>
+struct L3BlockCodec : BitPack {
+    static constexpr char MAGIC[8] = {'L', '3', 'B', 'L', 'K', '\n', '\0', '\0'};
+    static constexpr uint16_t VERSION = 1;
+    static constexpr uint32_t COLS = Schema::COLS;
+
+#pragma pack(push, 1)
+    struct BlockHeader {
+        char magic[8];
+        uint16_t version;
+        uint16_t flags;
+        uint32_t n_rows;
+        // encoding tag per column (ColEnc), indexed by Schema::COL_*
+        uint8_t enc[COLS];
+        uint8_t reserved0[8 - COLS % 8];
+        uint32_t off[COLS];
+        uint32_t len[COLS];
+    };
+#pragma pack(pop)
+
+    using Row = typename Schema::Row;
+
+    static inline bool check_magic(const BlockHeader& hdr) {
+        return std::memcmp(hdr.magic, MAGIC, sizeof(MAGIC)) == 0 && hdr.version == VERSION;
+    }
+
+    static void block_stats(const Row* rows, uint32_t n, BlockStats& st) {
+        st = BlockStats{};
+        st.min_ts = ~0ull;
+        st.min_px = ~0u;
+        for (uint32_t i = 0; i < n; ++i) {
+            const Row& r = rows[i];
+            st.min_ts = std::min(st.min_ts, r.ts_ns);
+            st.max_ts = std::max(st.max_ts, r.ts_ns);
+            st.min_px = std::min(st.min_px, r.price);
+            st.max_px = std::max(st.max_px, r.price);
+            st.n_side[r.side & 1]++;
+            st.sum_size += r.size;
+        }
+        if (n > 0) {
+            st.first_ts = rows[0].ts_ns;
+            st.last_ts = rows[n - 1].ts_ns;
+            st.first_px = rows[0].price;
+            st.last_px = rows[n - 1].price;
         }
+    }
 
-        std::vector<uint32_t> px_dz(hdr.n_rows);
-        if (hdr.px_bw == 0) {
-            fill(px_dz.begin(), px_dz.end(), 0);
+    static void encode_block(const Row* rows, uint32_t n, std::vector<uint8_t>& out) {
+        if (n == 0) {
+            return;
         }
-        else {
-            bitunpack_u32(src + hdr.len_px, hdr.n_rows, hdr.px_bw, px_dz.data());
+
+        BlockHeader hdr{};
+        std::memcpy(hdr.magic, MAGIC, sizeof(MAGIC));
+        hdr.version = VERSION;
+        hdr.flags = 0;
+        hdr.n_rows = n;
+
+        // exchange order ids are near monotonic, so FOR against the block min or DELTA_FOR usually wins for COL_ID,
+        // action has a handful of values and lands in DICT/RLE
+        std::vector<uint64_t> cols[COLS];
+        for (uint32_t c = 0; c < COLS; ++c) {
+            cols[c].resize(n);
+        }
+        for (uint32_t i = 0; i < n; ++i) {
+            cols[Schema::COL_ID][i] = rows[i].id;
+            cols[Schema::COL_TS][i] = rows[i].ts_ns;
+            cols[Schema::COL_PX][i] = rows[i].price;
+            cols[Schema::COL_SZ][i] = rows[i].size;
+            cols[Schema::COL_ACT][i] = rows[i].action;
+            cols[Schema::COL_SIDE][i] = rows[i].side;
+        }
+
+        const uint32_t start = static_cast<uint32_t>(out.size());
+        const uint32_t hdr_size = (sizeof(BlockHeader));
+        out.resize(start + hdr_size);
+
+        uint32_t off = hdr_size;
+        for (uint32_t c = 0; c < COLS; ++c) {
+            const size_t before = out.size();
+            hdr.enc[c] = static_cast<uint8_t>(ColCodec::encode(cols[c].data(), n, Schema::col_size(c), out));
+            hdr.off[c] = off;
+            hdr.len[c] = static_cast<uint32_t>(out.size() - before);
+            off += hdr.len[c];
+        }
+
+        std::memcpy(out.data() + start, &hdr, sizeof(BlockHeader));
+    }
+
+    // expect_rows is the row count from the block index, 0 when the block was found without one
+    static size_t decode_block(const uint8_t* src, size_t src_len, std::vector<Row>& rows_out,
+                               uint32_t expect_rows = 0) {
+        if (src_len < sizeof(BlockHeader)) {
+            throw std::runtime_error("block too small");
+        }
+
+        BlockHeader hdr{};
+        std::memcpy(&hdr, src, sizeof(BlockHeader));
+        if (!check_magic(hdr)) {
+            throw std::runtime_error("block magic incorrect");
+        }
+        if (!block_rows_ok(hdr.n_rows, expect_rows)) {
+            throw std::runtime_error("block row count corrupt");
         }
 
-        std::vector<uint8_t> side(hdr.n_rows);
-        bitunpack_u8(src + hdr.off_side, hdr.n_rows, side.data());
+        if (hdr.n_rows == 0) {
+            return sizeof(BlockHeader);
+        }
 
-        std::vector<uint8_t> type(hdr.n_rows);
-        bitunpack_u8(src + hdr.off_type, hdr.n_rows, type.data());
+        size_t end_off = sizeof(BlockHeader);
+        for (uint32_t c = 0; c < COLS; ++c) {
+            if (!span_ok(hdr.off[c], hdr.len[c], src_len)) {
+                throw std::runtime_error("block truncated");
+            }
+            end_off = std::max<size_t>(end_off, static_cast<size_t>(hdr.off[c]) + hdr.len[c]);
+        }
 
-        uint8_t* p_sz = src + hdr.off_sz;
+        const uint32_t n = hdr.n_rows;
+        rows_out.resize(n);
 
-        for (uint32_t i = 0; i < hdr.n_rows; ++i) {
+        std::vector<uint64_t> cols[COLS];
+        for (uint32_t c = 0; c < COLS; ++c) {
+            if (c == Schema::COL_PX) {
+                continue;
+            }
+            cols[c].resize(n);
+            ColCodec::decode(static_cast<ColEnc>(hdr.enc[c]), src + hdr.off[c], hdr.len[c], n,
+                             Schema::col_size(c), cols[c].data());
+        }
+
+        // delta encoded prices are rebuilt with a simd prefix sum
+        std::vector<uint32_t> px(n);
+        ColCodec::decode_u32(static_cast<ColEnc>(hdr.enc[Schema::COL_PX]), src + hdr.off[Schema::COL_PX],
+                             hdr.len[Schema::COL_PX], n, px.data());
+
+        for (uint32_t i = 0; i < n; ++i) {
             Row& r = rows_out[i];
-            uint64_t u = ts_delta[i];
-            r.ts_ts = hdr.base_ts + u * hdr.ts_scale_ns;
+            r.id = cols[Schema::COL_ID][i];
+            r.ts_ns = cols[Schema::COL_TS][i];
+            r.price = px[i];
+            r.size = static_cast<uint32_t>(cols[Schema::COL_SZ][i]);
+            r.action = static_cast<uint8_t>(cols[Schema::COL_ACT][i]);
+            r.side = static_cast<uint8_t>(cols[Schema::COL_SIDE][i]);
+        }
+
+        return end_off;
+    }
+};
+
+// any schema with col_kind() traits (factor files: ImbalanceSchema, VwapSchema, VoiSchema), rows are split into
+// columns with Schema::write_row_to_cols and each column is encoded by kind:
+// integer columns through ColCodec (sampled timestamps land in STRIDE, smooth series in DELTA/DELTA_FOR),
+// float columns through FloatCodec (gorilla xor / bit pattern deltas for smooth series)
+template <class Schema>
+struct SchemaBlockCodec : BitPack {
+    static constexpr char MAGIC[8] = {'S', 'C', 'H', 'B', 'L', 'K', '\n', '\0'};
+    static constexpr uint16_t VERSION = 1;
+    static constexpr uint32_t COLS = Schema::COLS;
+
+#pragma pack(push, 1)
+    struct BlockHeader {
+        char magic[8];
+        uint16_t version;
+        uint16_t flags;
+        uint32_t n_rows;
+        // encoding tag per column, ColEnc for integer columns and FloatEnc for ColKind::F32
+        uint8_t enc[COLS];
+        uint8_t reserved0[8 - COLS % 8];
+        uint32_t off[COLS];
+        uint32_t len[COLS];
+    };
+#pragma pack(pop)
+
+    using Row = typename Schema::Row;
+
+    static inline bool check_magic(const BlockHeader& hdr) {
+        return std::memcmp(hdr.magic, MAGIC, sizeof(MAGIC)) == 0 && hdr.version == VERSION;
+    }
+
+    // ts always, price/side/size only for schemas that name those columns
+    static void block_stats(const Row* rows, uint32_t n, BlockStats& st) {
+        st = BlockStats{};
+        st.min_ts = ~0ull;
+        st.min_px = ~0u;
+        std::vector<uint8_t> cols[COLS];
+        void* col_ptrs[COLS];
+        for (uint32_t c = 0; c < COLS; ++c) {
+            cols[c].resize(Schema::col_size(c));
+            col_ptrs[c] = cols[c].data();
+        }
+        for (uint32_t i = 0; i < n; ++i) {
+            Schema::write_row_to_cols(rows[i], col_ptrs, 0);
+            const uint64_t ts = col_value(cols, Schema::COL_TS);
+            st.min_ts = std::min(st.min_ts, ts);
+            st.max_ts = std::max(st.max_ts, ts);
+            st.first_ts = i == 0 ? ts : st.first_ts;
+            st.last_ts = ts;
+            if constexpr (requires { Schema::COL_PX; }) {
+                const uint32_t px = static_cast<uint32_t>(col_value(cols, Schema::COL_PX));
+                st.min_px = std::min(st.min_px, px);
+                st.max_px = std::max(st.max_px, px);
+                st.first_px = i == 0 ? px : st.first_px;
+                st.last_px = px;
+            }
+            if constexpr (requires { Schema::COL_SIDE; }) {
+                st.n_side[col_value(cols, Schema::COL_SIDE) & 1]++;
+            }
+            if constexpr (requires { Schema::COL_QTY; }) {
+                float q;
+                std::memcpy(&q, cols[Schema::COL_QTY].data(), sizeof(float));
+                st.sum_size += q;
+            }
+            else if constexpr (requires { Schema::COL_SZ; }) {
+                st.sum_size += static_cast<double>(col_value(cols, Schema::COL_SZ));
+            }
+        }
+        if (n == 0 || st.min_px == ~0u) {
+            st.min_px = 0;
+        }
+    }
 
-            int32_t dx = zigzag_dec32(px_dz[i]);
-            uint64_t px = hdr.base_px + dx;
+    static void encode_block(const Row* rows, uint32_t n, std::vector<uint8_t>& out) {
+        if (n == 0) {
+            return;
+        }
+
+        BlockHeader hdr{};
+        std::memcpy(hdr.magic, MAGIC, sizeof(MAGIC));
+        hdr.version = VERSION;
+        hdr.flags = 0;
+        hdr.n_rows = n;
+
+        std::vector<uint8_t> cols[COLS];
+        void* col_ptrs[COLS];
+        for (uint32_t c = 0; c < COLS; ++c) {
+            cols[c].resize(static_cast<size_t>(n) * Schema::col_size(c));
+            col_ptrs[c] = cols[c].data();
+        }
+        for (uint32_t i = 0; i < n; ++i) {
+            Schema::write_row_to_cols(rows[i], col_ptrs, i);
+        }
+
+        const uint32_t start = static_cast<uint32_t>(out.size());
+        const uint32_t hdr_size = (sizeof(BlockHeader));
+        out.resize(start + hdr_size);
+
+        std::vector<uint64_t> wide(n);
+        uint32_t off = hdr_size;
+        for (uint32_t c = 0; c < COLS; ++c) {
+            const size_t before = out.size();
+            const uint8_t* p = cols[c].data();
+            switch (Schema::col_kind(c)) {
+            case ColKind::F32:
+                hdr.enc[c] = static_cast<uint8_t>(FloatCodec::encode(reinterpret_cast<const float*>(p), n, out));
+                break;
+            case ColKind::U8:
+                widen(reinterpret_cast<const uint8_t*>(p), n, wide.data());
+                hdr.enc[c] = static_cast<uint8_t>(ColCodec::encode(wide.data(), n, sizeof(uint8_t), out));
+                break;
+            case ColKind::U32:
+                widen(reinterpret_cast<const uint32_t*>(p), n, wide.data());
+                hdr.enc[c] = static_cast<uint8_t>(ColCodec::encode(wide.data(), n, sizeof(uint32_t), out));
+                break;
+            case ColKind::U64:
+                hdr.enc[c] = static_cast<uint8_t>(
+                    ColCodec::encode(reinterpret_cast<const uint64_t*>(p), n, sizeof(uint64_t), out));
+                break;
+            }
+            hdr.off[c] = off;
+            hdr.len[c] = static_cast<uint32_t>(out.size() - before);
+            off += hdr.len[c];
+        }
+
+        std::memcpy(out.data() + start, &hdr, sizeof(BlockHeader));
+    }
+
+    // expect_rows is the row count from the block index, 0 when the block was found without one
+    static size_t decode_block(const uint8_t* src, size_t src_len, std::vector<Row>& rows_out,
+                               uint32_t expect_rows = 0) {
+        if (src_len < sizeof(BlockHeader)) {
+            throw std::runtime_error("block too small");
+        }
 
-            if (px < 0 || px > std::numeric_limits<uint32_t>::max()) {
-                throw std::runtime_error("price overflow");
+        BlockHeader hdr{};
+        std::memcpy(&hdr, src, sizeof(BlockHeader));
+        if (!check_magic(hdr)) {
+            throw std::runtime_error("block magic incorrect");
+        }
+        if (!block_rows_ok(hdr.n_rows, expect_rows)) {
+            throw std::runtime_error("block row count corrupt");
+        }
+
+        if (hdr.n_rows == 0) {
+            return sizeof(BlockHeader);
+        }
+
+        size_t end_off = sizeof(BlockHeader);
+        for (uint32_t c = 0; c < COLS; ++c) {
+            if (!span_ok(hdr.off[c], hdr.len[c], src_len)) {
+                throw std::runtime_error("block truncated");
             }
+            end_off = std::max<size_t>(end_off, static_cast<size_t>(hdr.off[c]) + hdr.len[c]);
+        }
 
-            float fsz;
-            std::memcpy(&fsz, p_sz + i * sizeof(float), sizeof(float));
-            r.size = fsz;
-            r.side = side[i];
-            if (type[i] == 1) {
-                r.type = 'T';
-            } else {
-                r.type = 'L';
+        const uint32_t n = hdr.n_rows;
+        rows_out.resize(n);
+
+        std::vector<uint8_t> cols[COLS];
+        const void* col_ptrs[COLS];
+        std::vector<uint64_t> wide;
+        for (uint32_t c = 0; c < COLS; ++c) {
+            cols[c].resize(static_cast<size_t>(n) * Schema::col_size(c));
+            col_ptrs[c] = cols[c].data();
+            uint8_t* p = cols[c].data();
+            const uint8_t* col_src = src + hdr.off[c];
+            switch (Schema::col_kind(c)) {
+            case ColKind::F32:
+                FloatCodec::decode(static_cast<FloatEnc>(hdr.enc[c]), col_src, hdr.len[c], n,
+                                   reinterpret_cast<float*>(p));
+                break;
+            case ColKind::U8:
+                wide.resize(n);
+                ColCodec::decode(static_cast<ColEnc>(hdr.enc[c]), col_src, hdr.len[c], n, sizeof(uint8_t),
+                                 wide.data());
+                narrow(wide.data(), n, p);
+                break;
+            case ColKind::U32:
+                ColCodec::decode_u32(static_cast<ColEnc>(hdr.enc[c]), col_src, hdr.len[c], n,
+                                     reinterpret_cast<uint32_t*>(p));
+                break;
+            case ColKind::U64:
+                ColCodec::decode(static_cast<ColEnc>(hdr.enc[c]), col_src, hdr.len[c], n, sizeof(uint64_t),
+                                 reinterpret_cast<uint64_t*>(p));
+                break;
             }
         }
 
-        uint32_t end_off = std::max({
-            hdr.off_ts + hdr.len_ts,
-            hdr.off_px + hdr.len_px,
-            hdr.off_sz + hdr.len_sz,
-            hdr.off_side + hdr.len_side,
-            hdr.off_type + hdr.len_type
-        });
-        return std::max<uint32_t>(end_off, sizeof(BlockHeader));
+        for (uint32_t i = 0; i < n; ++i) {
+            Schema::read_row_from_cols(rows_out[i], col_ptrs, i);
+        }
+
+        return end_off;
+    }
+
+private:
+    static uint64_t col_value(const std::vector<uint8_t>* cols, uint32_t c) {
+        uint64_t v = 0;
+        std::memcpy(&v, cols[c].data(), Schema::col_size(c));
+        return v;
+    }
+
+    template <class T>
+    static void widen(const T* src, uint32_t n, uint64_t* out) {
+        for (uint32_t i = 0; i < n; ++i) {
+            out[i] = src[i];
+        }
+    }
+
+    static void narrow(const uint64_t* src, uint32_t n, uint8_t* out) {
+        for (uint32_t i = 0; i < n; ++i) {
+            out[i] = static_cast<uint8_t>(src[i]);
+        }
     }
 };
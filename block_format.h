@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+
+// on disk layout of a .blocks day file:
+// [DayFileHeader][block 0][block 1]...[block n-1][BlockIndexEntry x blocks_total]
+// bytes_total only covers the blocks, the index sits right after them and is written on close
+
+static constexpr uint32_t BLOCK_INDEX_VERSION = 3;
+
+// [off, off + len) inside [0, limit), checked without computing off + len so a corrupted header cannot wrap past it
+inline bool span_ok(uint64_t off, uint64_t len, uint64_t limit) {
+    return off <= limit && len <= limit - off;
+}
+
+// most rows one block may hold, BlockWriterOpt::block_rows is checked against it and decoders reject bigger headers
+// before sizing anything from n_rows
+static constexpr uint32_t MAX_BLOCK_ROWS = 1u << 20;
+
+// n_rows from a block header against the row count its index entry recorded, expect_rows 0 = no index to compare with
+inline bool block_rows_ok(uint32_t n_rows, uint32_t expect_rows) {
+    return n_rows <= MAX_BLOCK_ROWS && (expect_rows == 0 || n_rows == expect_rows);
+}
+
+#pragma pack(push,1)
+struct DayFileHeader {
+    uint64_t rows_total;
+    uint64_t bytes_total;
+    uint32_t yyyymmdd;
+    uint32_t blocks_total;
+    uint64_t index_off; // 0 when the writer never got to close the file
+    uint32_t index_version;
+    uint32_t reserved0;
+};
+
+// zone map + pre-aggregates of one block, filled by Codec::block_stats, lets readers skip blocks without
+// decoding them and lets BlockQueryT answer count/volume/ohlc questions from the index alone
+struct BlockStats {
+    uint64_t min_ts;
+    uint64_t max_ts;
+    uint32_t min_px;
+    uint32_t max_px;
+    uint32_t n_side[2]; // ask = 0, bid = 1
+    uint32_t n_type[2]; // level = 0, trade = 1, zero for schemas without a type column
+    double sum_size;
+    uint64_t first_ts;
+    uint64_t last_ts;
+    uint32_t first_px;
+    uint32_t last_px;
+
+    inline bool overlaps_ts(uint64_t lo, uint64_t hi) const { return min_ts <= hi && max_ts >= lo; }
+    inline bool overlaps_px(uint32_t lo, uint32_t hi) const { return min_px <= hi && max_px >= lo; }
+    inline bool has_trades() const { return n_type[1] != 0; }
+};
+
+struct BlockIndexEntry {
+    uint64_t off; // from the start of the file
+    uint32_t len;
+    uint32_t rows;
+    uint32_t crc; // crc32c over the encoded block
+    uint32_t reserved0;
+    BlockStats stats;
+};
+#pragma pack(pop)
@@ -0,0 +1,149 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include "block_reader.h"
+
+// count/volume/ohlc queries answered from the block index pre-aggregates (BlockStats),
+// only blocks that straddle a bar boundary get decoded. aggregates cover every row in the file,
+// so on l2/l3 files volume is the summed size of all events, on trade files it is traded volume
+template <class Schema, class Codec>
+class BlockQueryT {
+public:
+    using Reader = BlockReaderT<Schema, Codec>;
+    using Row = typename Schema::Row;
+
+    struct DaySummary {
+        uint32_t yyyymmdd;
+        uint64_t rows;
+        double sum_size;
+        uint64_t first_ts;
+        uint64_t last_ts;
+        uint32_t open;
+        uint32_t high;
+        uint32_t low;
+        uint32_t close;
+    };
+
+    struct Bar {
+        uint64_t start_ns;
+        uint64_t rows;
+        double sum_size;
+        uint32_t open;
+        uint32_t high;
+        uint32_t low;
+        uint32_t close;
+    };
+
+    explicit BlockQueryT(const BlockReaderOpt& opt) : reader_(opt) {
+    }
+
+    // index only, never decodes a block
+    std::vector<DaySummary> day_summaries() {
+        std::vector<DaySummary> out;
+        reader_.visit_day_indexes([&](const typename Reader::DayIndex& day) {
+            DaySummary s{day.hdr->yyyymmdd, 0, 0.0, 0, 0, 0, 0, ~0u, 0};
+            for (uint32_t k = 0; k < day.n_blocks; ++k) {
+                const BlockStats& st = day.entries[k].stats;
+                if (day.entries[k].rows == 0) {
+                    continue;
+                }
+                if (s.rows == 0) {
+                    s.first_ts = st.first_ts;
+                    s.open = st.first_px;
+                }
+                s.rows += day.entries[k].rows;
+                s.sum_size += st.sum_size;
+                s.last_ts = st.last_ts;
+                s.close = st.last_px;
+                s.high = std::max(s.high, st.max_px);
+                s.low = std::min(s.low, st.min_px);
+            }
+            if (s.rows == 0) {
+                s.low = 0;
+            }
+            out.push_back(s);
+        });
+        return out;
+    }
+
+    // bars aligned to multiples of interval_ns since the epoch, blocks are assumed to be in time order
+    std::vector<Bar> bars(uint64_t interval_ns) {
+        if (interval_ns == 0) {
+            throw std::runtime_error("[blockquery] bar interval must be > 0");
+        }
+
+        std::vector<Bar> out;
+        reader_.visit_day_indexes([&](const typename Reader::DayIndex& day) {
+            for (uint32_t k = 0; k < day.n_blocks; ++k) {
+                const BlockIndexEntry& e = day.entries[k];
+                if (e.rows == 0) {
+                    continue;
+                }
+                const uint64_t lo = e.stats.min_ts / interval_ns;
+                const uint64_t hi = e.stats.max_ts / interval_ns;
+                if (lo == hi) {
+                    Bar& b = bar_at(out, lo * interval_ns);
+                    if (b.rows == 0) {
+                        b.open = e.stats.first_px;
+                    }
+                    b.rows += e.rows;
+                    b.sum_size += e.stats.sum_size;
+                    b.high = std::max(b.high, e.stats.max_px);
+                    b.low = std::min(b.low, e.stats.min_px);
+                    b.close = e.stats.last_px;
+                    continue;
+                }
+
+                // edge block, fold in row by row
+                const auto view = day.decode(k);
+                for (uint32_t i = 0; i < view.n_rows; ++i) {
+                    const Row& r = view.data[i];
+                    Bar& b = bar_at(out, r.ts_ns / interval_ns * interval_ns);
+                    if (b.rows == 0) {
+                        b.open = r.price;
+                    }
+                    b.rows++;
+                    b.sum_size += row_size(r);
+                    b.high = std::max(b.high, r.price);
+                    b.low = std::min(b.low, r.price);
+                    b.close = r.price;
+                }
+            }
+        });
+        return out;
+    }
+
+    uint64_t decoded_blocks() const noexcept { return reader_.decoded_blocks(); }
+
+private:
+    static double row_size(const Row& r) {
+        if constexpr (requires { r.qty; }) {
+            return r.qty;
+        }
+        else {
+            return static_cast<double>(r.size);
+        }
+    }
+
+    static Bar& bar_at(std::vector<Bar>& bars, uint64_t start_ns) {
+        if (bars.empty() || bars.back().start_ns < start_ns) {
+            bars.push_back(Bar{start_ns, 0, 0.0, 0, 0, ~0u, 0});
+            return bars.back();
+        }
+        if (bars.back().start_ns == start_ns) {
+            return bars.back();
+        }
+        auto it = std::lower_bound(bars.begin(), bars.end(), start_ns,
+                                   [](const Bar& b, uint64_t s) { return b.start_ns < s; });
+        if (it != bars.end() && it->start_ns == start_ns) {
+            return *it;
+        }
+        return *bars.insert(it, Bar{start_ns, 0, 0.0, 0, 0, ~0u, 0});
+    }
+
+    Reader reader_;
+};
+
+using L3BlockQuery = BlockQueryT<L3Schema, L3BlockCodec<L3Schema>>;
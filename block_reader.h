@@ -3,6 +3,9 @@
 #include <cstddef>
 #include <cstring>
 #include <string>
+#include <string_view>
+#include <charconv>
+#include <filesystem>
 #include <functional>
 #include <vector>
 #include <algorithm>
@@ -13,23 +16,42 @@
 #include <unistd.h>
 #include "schemas.h"
 #include "block_codec.h"
+#include "block_format.h"
+#include "checksum.h"
+#include "catalog.h"
+#include "perf_counters.h"
+
+namespace fs = std::filesystem;
+
+enum class VerifyMode : uint8_t {
+    OFF, // trust the blocks
+    ALWAYS, // crc every block before decoding it
+    SAMPLED, // crc one block out of verify_sample_every
+};
 
 struct BlockReaderOpt {
     std::string base_dir;
     std::string product;
     uint32_t date_from = 00000000;
     uint32_t date_to = 99999999;
+    VerifyMode verify = VerifyMode::OFF;
+    uint32_t verify_sample_every = 64;
+    // skip blocks that fail the crc or the decoder (needs the block index) instead of throwing
+    bool recover = false;
+    bool use_catalog = true; // plan days and rows from <product>-BLOCKS/catalog.idx when complete, else list the dir
 };
 
 template <class Schema, class Codec>
 class BlockReaderT {
 public:
 
-    BlockReaderT(BlockReaderOpt& opt)
-        : opt_(std::move(opt)) {
+    explicit BlockReaderT(const BlockReaderOpt& opt)
+        : opt_(opt) {
         build_day_file_list();
     }
 
+    ~BlockReaderT() { unmap_(); }
+
     using Row = typename Schema::Row;
 
     struct RowsView {
@@ -41,52 +63,273 @@ public:
 
     template <class Fn>
     void visit_day_files(Fn&& fn) {
-        for (int i = 0; i < files_.size(); i++) {
+        visit_day_files([](const BlockStats&) { return true; }, std::forward<Fn>(fn));
+    }
+
+    // pred(const BlockStats&) is checked against each block's zone map from the index, blocks it rejects are
+    // never decoded. files without an index can't be skipped and are decoded in full
+    template <class Pred, class Fn>
+    void visit_day_files(Pred&& pred, Fn&& fn) {
+        for (size_t i = 0; i < files_.size(); i++) {
             map(files_[i].path);
+            if (const BlockIndexEntry* idx = block_index()) {
+                visit_indexed(idx, pred, fn);
+            }
+            else {
+                visit_sequential(fn);
+            }
+            unmap_();
+        }
+    }
 
-            const size_t file_begin = sizeof(DayFileHeader);
-            const size_t file_limit = std::min<size_t>(file_begin + hdr_.bytes_total,
-                                                       mapped_bytes_);
+    // crc pass over every block of every day without decoding, returns the number of bad blocks
+    uint64_t verify_day_files() {
+        uint64_t bad = 0;
+        for (size_t i = 0; i < files_.size(); i++) {
+            map(files_[i].path);
+            const BlockIndexEntry* idx = block_index();
+            if (!idx) {
+                unmap_();
+                throw std::runtime_error("[blockreader] file has no block index to verify against");
+            }
+            ::madvise(base_, mapped_bytes_, MADV_SEQUENTIAL);
+            for (uint32_t k = 0; k < hdr_.blocks_total; ++k) {
+                if (!block_ok(idx[k], true)) {
+                    ++bad;
+                }
+            }
+            unmap_();
+        }
+        bad_blocks_ += bad;
+        return bad;
+    }
 
-            size_t off = file_begin;
-            size_t count = 0;
-            const uint32_t max_blocks = hdr_.blocks_total;
+    // one mapped day file, for callers that plan from the index and only decode the blocks they need
+    struct DayIndex {
+        BlockReaderT* reader;
+        const DayFileHeader* hdr;
+        const BlockIndexEntry* entries;
+        uint32_t n_blocks;
 
-            rows_.clear();
+        RowsView decode(uint32_t k) const { return reader->decode_entry(entries[k]); }
+    };
 
-            while (off < file_limit && count < max_blocks) {
-                uint8_t* blk = base_ + off;
-                size_t len = file_limit - off;
-                size_t consumed = Codec::decode_block(blk, len, rows_);
-                if (consumed == 0) {
-                    break;
+    // files without a block index throw, there is nothing to plan from
+    template <class Fn>
+    void visit_day_indexes(Fn&& fn) {
+        for (size_t i = 0; i < files_.size(); i++) {
+            map(files_[i].path);
+            const BlockIndexEntry* idx = block_index();
+            if (!idx) {
+                unmap_();
+                throw std::runtime_error("[blockreader] file has no block index");
+            }
+            DayIndex day{this, &hdr_, idx, hdr_.blocks_total};
+            {
+                HFT_PERF_PHASE(VISIT);
+                fn(day);
+            }
+            unmap_();
+        }
+    }
+
+    uint64_t bad_blocks() const noexcept { return bad_blocks_; }
+    uint64_t skipped_blocks() const noexcept { return skipped_blocks_; }
+    uint64_t decoded_blocks() const noexcept { return decoded_blocks_; }
+
+    const std::vector<uint32_t>& days() const noexcept { return days_; }
+    const std::vector<fs::path>& paths() const noexcept { return paths_only_; }
+    // row count per day from the catalog, 0 for days still being written and for every day of a scanned directory
+    const std::vector<uint64_t>& day_rows() const noexcept { return rows_only_; }
+    bool from_catalog() const noexcept { return from_catalog_; }
+
+    // rebuilds the catalog from the .blocks files on disk and marks it complete, for directories written before the
+    // catalog existed or changed by hand. entries the writer recorded are kept, files without an index (never
+    // closed) are listed with unknown rows
+    static bool rebuild_catalog(const BlockReaderOpt& opt) {
+        BlockReaderOpt all = opt;
+        all.use_catalog = false;
+        all.date_from = 0;
+        all.date_to = 99999999;
+        BlockReaderT r(all);
+        const fs::path dir = product_dir(all);
+        if (!fs::exists(dir)) {
+            return false;
+        }
+        std::vector<CatalogEntry> entries;
+        for (const DayFile& f : r.files_) {
+            entries.push_back(r.scanned_entry(f));
+        }
+        return DayCatalog::backfill(dir, std::move(entries));
+    }
+
+private:
+
+    // null for files without a (valid) index, those can only be walked block after block
+    const BlockIndexEntry* block_index() const {
+        if (hdr_.index_off == 0 || hdr_.index_version != BLOCK_INDEX_VERSION) {
+            return nullptr;
+        }
+        const uint64_t bytes = static_cast<uint64_t>(hdr_.blocks_total) * sizeof(BlockIndexEntry);
+        if (hdr_.index_off < sizeof(DayFileHeader) || !span_ok(hdr_.index_off, bytes, mapped_bytes_)) {
+            return nullptr;
+        }
+        return reinterpret_cast<const BlockIndexEntry*>(base_ + hdr_.index_off);
+    }
+
+    // end of the block area, bytes_total from a damaged header can be anything (map() checked the header fits)
+    size_t file_limit() const {
+        return span_ok(sizeof(DayFileHeader), hdr_.bytes_total, mapped_bytes_)
+                   ? sizeof(DayFileHeader) + hdr_.bytes_total
+                   : mapped_bytes_;
+    }
+
+    bool block_ok(const BlockIndexEntry& e, bool verify) const {
+        if (e.off < sizeof(DayFileHeader) || !span_ok(e.off, e.len, file_limit())) {
+            return false;
+        }
+        return !verify || Crc32c::compute(base_ + e.off, e.len) == e.crc;
+    }
+
+    bool should_verify() {
+        switch (opt_.verify) {
+        case VerifyMode::OFF: return false;
+        case VerifyMode::ALWAYS: return true;
+        case VerifyMode::SAMPLED: return opt_.verify_sample_every == 0 ||
+                   (verify_counter_++ % opt_.verify_sample_every) == 0;
+        }
+        return false;
+    }
+
+    RowsView decode_entry(const BlockIndexEntry& e) {
+        if (!block_ok(e, should_verify())) {
+            ++bad_blocks_;
+            throw std::runtime_error("[blockreader] block failed verification");
+        }
+        rows_.clear();
+        {
+            HFT_PERF_PHASE(DECODE_BLOCK);
+            Codec::decode_block(base_ + e.off, e.len, rows_, e.rows);
+        }
+        decoded_blocks_++;
+        return RowsView{rows_.data(), static_cast<uint32_t>(rows_.size()), e.off, hdr_.yyyymmdd};
+    }
+
+    template <class Pred, class Fn>
+    void visit_indexed(const BlockIndexEntry* idx, Pred& pred, Fn& fn) {
+        for (uint32_t k = 0; k < hdr_.blocks_total; ++k) {
+            const BlockIndexEntry& e = idx[k];
+            if (!pred(e.stats)) {
+                ++skipped_blocks_;
+                continue;
+            }
+            if (!block_ok(e, should_verify())) {
+                ++bad_blocks_;
+                if (opt_.recover) {
+                    continue;
                 }
-                if (off + consumed > file_limit) {
-                    break;
+                throw std::runtime_error("[blockreader] block failed verification");
+            }
+
+            rows_.clear();
+            try {
+                HFT_PERF_PHASE(DECODE_BLOCK);
+                Codec::decode_block(base_ + e.off, e.len, rows_, e.rows);
+                decoded_blocks_++;
+            }
+            catch (const std::runtime_error&) {
+                ++bad_blocks_;
+                if (opt_.recover) {
+                    continue;
                 }
+                throw;
+            }
 
-                RowsView view{rows_.data(), static_cast<uint32_t>(rows_.size()), off, hdr_.yyyymmdd};
+            RowsView view{rows_.data(), static_cast<uint32_t>(rows_.size()), e.off, hdr_.yyyymmdd};
+            {
+                HFT_PERF_PHASE(VISIT);
                 fn(view);
-
-                off += consumed;
-                count += 1;
             }
-            unmap_();
         }
     }
 
-private:
+    template <class Fn>
+    void visit_sequential(Fn& fn) {
+        const size_t file_begin = sizeof(DayFileHeader);
+        const size_t file_limit = this->file_limit();
+
+        size_t off = file_begin;
+        size_t count = 0;
+        const uint32_t max_blocks = hdr_.blocks_total;
+
+        rows_.clear();
+
+        while (off < file_limit && count < max_blocks) {
+            uint8_t* blk = base_ + off;
+            size_t len = file_limit - off;
+            size_t consumed;
+            try {
+                HFT_PERF_PHASE(DECODE_BLOCK);
+                consumed = Codec::decode_block(blk, len, rows_);
+                decoded_blocks_++;
+            }
+            catch (const std::runtime_error&) {
+                // without an index there is no way to find the next block boundary
+                ++bad_blocks_;
+                if (opt_.recover) {
+                    break;
+                }
+                throw;
+            }
+            if (consumed == 0) {
+                break;
+            }
+            if (!span_ok(off, consumed, file_limit)) {
+                break;
+            }
+
+            RowsView view{rows_.data(), static_cast<uint32_t>(rows_.size()), off, hdr_.yyyymmdd};
+            {
+                HFT_PERF_PHASE(VISIT);
+                fn(view);
+            }
+
+            off += consumed;
+            count += 1;
+        }
+    }
 
     struct DayFile {
         uint32_t yyyymmdd;
         fs::path path;
+        uint64_t rows;
     };
 
-    bool parse_yyyymmdd(std::string_view name, uint32_t& out) {
-        if (name.size() < 12) {
+    static fs::path product_dir(const BlockReaderOpt& opt) { return fs::path(opt.base_dir) / (opt.product + "-BLOCKS"); }
+
+    CatalogEntry scanned_entry(const DayFile& f) {
+        const std::string name = f.path.filename().string();
+        CatalogEntry e = DayCatalog::make_entry(f.yyyymmdd, name, CatalogCodec::BLOCKS, Codec::VERSION,
+                                                Schema::VERSION, 0, 0, 0, 0, 0, CATALOG_DAY_OPEN);
+        try {
+            map(f.path);
+        }
+        catch (const std::runtime_error&) {
+            return e;
+        }
+        if (const BlockIndexEntry* idx = block_index()) {
+            e = DayCatalog::blocks_entry(f.yyyymmdd, name, Codec::VERSION, Schema::VERSION, hdr_.rows_total,
+                                         mapped_bytes_, idx, hdr_.blocks_total);
+        }
+        unmap_();
+        return e;
+    }
+
+    static bool parse_yyyymmdd(std::string_view name, uint32_t& out) {
+        if (name.size() < 15) {
             return false;
         }
-        std::string_view stem = name.substr(name.size() - 12, 8);
+        std::string_view stem = name.substr(name.size() - 15, 8);
         uint32_t val{};
         auto [p, ec] = std::from_chars(stem.data(), stem.data()+8, val);
         if (ec != std::errc{} || p != stem.data()+8) {
@@ -96,8 +339,48 @@ private:
         return true;
     }
 
+    // days and rows from a complete catalog without touching the directory. false when there is none or an entry
+    // does not read back as a .blocks day file, the caller scans then
+    bool load_catalog(const fs::path& dir) {
+        DayCatalog cat(dir);
+        if (!cat.complete()) {
+            return false;
+        }
+        std::vector<DayFile> files;
+        for (const CatalogEntry& e : cat) {
+            const std::string name = DayCatalog::file_name(e);
+            uint32_t d = 0;
+            if (e.codec != static_cast<uint8_t>(CatalogCodec::BLOCKS) || name.size() != 15 ||
+                fs::path(name).extension() != ".blocks" || !parse_yyyymmdd(name, d) || d != e.yyyymmdd) {
+                return false;
+            }
+            if (d < opt_.date_from || d > opt_.date_to) {
+                continue;
+            }
+            const bool final_rows = !(e.flags & CATALOG_DAY_OPEN) && e.codec_version == Codec::VERSION &&
+                e.schema_version == Schema::VERSION;
+            files.push_back(DayFile{d, dir / name, final_rows ? e.rows : 0});
+        }
+        files_.swap(files);
+        return true;
+    }
+
     void build_day_file_list() {
-        const fs::path dir = fs::path(opt_.base_dir) / opt_.product;
+        // BlockWriterT writes <base>/<product>-BLOCKS/YYYYMMDD.blocks
+        const fs::path dir = product_dir(opt_);
+        from_catalog_ = opt_.use_catalog && load_catalog(dir);
+        if (!from_catalog_) {
+            scan_day_files(dir);
+        }
+        for (auto& f : files_) {
+            days_.push_back(f.yyyymmdd);
+            paths_only_.push_back(f.path);
+            rows_only_.push_back(f.rows);
+        }
+        //std::cout << days_.size() << std::endl;
+    }
+
+    void scan_day_files(const fs::path& dir) {
         if (!fs::exists(dir)) {
             return;
         }
@@ -106,7 +389,7 @@ private:
             if (!e.is_regular_file()) {
                 continue;
             }
-            if (e.path().extension() != ".bin") {
+            if (e.path().extension() != ".blocks") {
                 continue;
             }
 
@@ -118,15 +401,10 @@ private:
             if (d < opt_.date_from || d > opt_.date_to) {
                 continue;
             }
-            files_.push_back(DayFile{d, e.path()});
+            files_.push_back(DayFile{d, e.path(), 0});
         }
         std::sort(files_.begin(), files_.end(),
                   [](const DayFile& a, const DayFile& b) { return a.yyyymmdd < b.yyyymmdd; });
-        for (auto& f : files_) {
-            days_.push_back(f.yyyymmdd);
-            paths_only_.push_back(f.path);
-        }
-        //std::cout << days_.size() << std::endl;
     }
 
 
@@ -178,5 +456,17 @@ private:
     std::vector<DayFile> files_;
     std::vector<uint32_t> days_;
     std::vector<fs::path> paths_only_;
+    std::vector<uint64_t> rows_only_;
+    bool from_catalog_{false};
     size_t file_idx_{0};
+    uint64_t verify_counter_{0};
+    uint64_t bad_blocks_{0};
+    uint64_t skipped_blocks_{0};
+    uint64_t decoded_blocks_{0};
 };
+
+using L2BlockReader = BlockReaderT<L2Schema, SchemaBlockCodec<L2Schema>>;
+using L3BlockReader = BlockReaderT<L3Schema, L3BlockCodec<L3Schema>>;
+using ImbalanceBlockReader = BlockReaderT<ImbalanceSchema, SchemaBlockCodec<ImbalanceSchema>>;
+using VwapBlockReader = BlockReaderT<VwapSchema, SchemaBlockCodec<VwapSchema>>;
+using VoiBlockReader = BlockReaderT<VoiSchema, SchemaBlockCodec<VoiSchema>>;
@@ -16,6 +16,10 @@
 #include <sys/mman.h>
 #include "schemas.h"
 #include "block_codec.h"
+#include "block_format.h"
+#include "checksum.h"
+#include "perf_counters.h"
+#include "catalog.h"
 #ifndef MREMAP_MAYMOVE
 #define MREMAP_MAYMOVE 1
 #endif
@@ -24,28 +28,22 @@ struct BlockWriterOpt {
     std::string base_dir;
     std::string product;
     uint32_t fsync_every_blocks{0};
-    uint32_t block_rows{8192};
+    uint32_t block_rows{8192}; // at most MAX_BLOCK_ROWS
 
     BlockWriterOpt(std::string base, std::string prod)
         : base_dir(std::move(base)), product(std::move(prod)) {
     }
 };
 
-#pragma pack(push,1)
-struct DayFileHeader {
-    uint64_t rows_total;
-    uint64_t bytes_total;
-    uint32_t yyyymmdd;
-    uint32_t blocks_total;
-};
-#pragma pack(pop)
-
 template <class Schema, class Codec>
 class BlockWriterT {
 public:
     using Row = typename Schema::Row;
 
     explicit BlockWriterT(const BlockWriterOpt& opt) : opt_(opt) {
+        if (opt_.block_rows == 0 || opt_.block_rows > MAX_BLOCK_ROWS) {
+            throw std::runtime_error("[blockwriter]: block_rows must be in [1, MAX_BLOCK_ROWS]");
+        }
     }
 
     ~BlockWriterT() { close(); }
@@ -86,6 +84,7 @@ public:
         }
 
         flush_block();
+        write_index();
         close_map();
 
         header_.rows_total = rows_total_;
@@ -105,12 +104,15 @@ public:
         ::close(fd_);
         fd_ = -1;
 
+        update_catalog();
+
         path_.clear();
         rows_total_ = 0;
         bytes_total_ = 0;
         bytes_since_sync_ = 0;
         curr_day_ = 0;
         buf_.clear();
+        index_.clear();
         map_base_ = nullptr;
         map_len_ = 0;
         file_off_ = 0;
@@ -139,6 +141,7 @@ private:
     uint64_t file_off_{0};
     std::vector<Row> buf_;
     std::vector<uint8_t> block_buf_;
+    std::vector<BlockIndexEntry> index_;
 
     static bool mkdir_p(const std::string& dir) {
         std::error_code ex;
@@ -160,8 +163,20 @@ private:
         return (x + (a - 1)) / a * a;
     }
 
+    std::string product_dir() const { return opt_.base_dir + "/" + opt_.product + "-BLOCKS"; }
+
+    // the index is still in memory at this point
+    void update_catalog() {
+        const CatalogEntry entry =
+            DayCatalog::blocks_entry(header_.yyyymmdd, date_string(header_.yyyymmdd) + ".blocks", Codec::VERSION,
+                                     Schema::VERSION, rows_total_, file_off_, index_.data(), index_.size());
+        if (!DayCatalog::upsert(product_dir(), entry)) {
+            throw std::runtime_error("[blockwriter]: catalog update failed");
+        }
+    }
+
     void open_day_file(uint32_t yyyymmdd) {
-        const std::string dir = opt_.base_dir + "/" + opt_.product + "-BLOCKS";
+        const std::string dir = product_dir();
         if (!mkdir_p(dir)) {
             throw std::runtime_error("[blockwriter]: mkdir failed");
         }
@@ -206,6 +221,14 @@ private:
         ::posix_fadvise(fd_, 0, static_cast<off_t>(map_len_), POSIX_FADV_SEQUENTIAL);
         ::madvise(map_base_, map_len_, MADV_SEQUENTIAL);
 
+        // readers plan from the catalog, the day is listed from the moment its file exists
+        const CatalogEntry entry = DayCatalog::make_entry(
+            yyyymmdd, date_string(yyyymmdd) + ".blocks", CatalogCodec::BLOCKS, Codec::VERSION, Schema::VERSION, 0,
+            file_off_, 0, 0, 0, CATALOG_DAY_OPEN);
+        if (!DayCatalog::upsert(dir, entry)) {
+            throw std::runtime_error("[blockwriter]: catalog update failed");
+        }
+
         std::fprintf(stdout, "[blockwriter:%u] opened %s\n", yyyymmdd, path_.c_str());
     }
 
@@ -256,12 +279,21 @@ private:
     }
 
     void append_rows_as_block(const Row* rows, uint32_t n) {
+        HFT_PERF_PHASE(APPEND_BLOCK);
         block_buf_.clear();
         Codec::encode_block(rows, n, block_buf_);
         ensure_chunk(block_buf_.size());
         //std::cout << "encoded sz: " <<  block_buf_.size() << std::endl;
         std::memcpy(map_base_ + file_off_, block_buf_.data(), block_buf_.size());
 
+        BlockIndexEntry e{};
+        e.off = file_off_;
+        e.len = static_cast<uint32_t>(block_buf_.size());
+        e.rows = n;
+        e.crc = Crc32c::compute(block_buf_.data(), block_buf_.size());
+        Codec::block_stats(rows, n, e.stats);
+        index_.push_back(e);
+
         file_off_ += block_buf_.size();
         rows_total_ += n;
         bytes_total_ += block_buf_.size();
@@ -274,6 +306,19 @@ private:
         header_.blocks_total++;
     }
 
+    void write_index() {
+        // 8 byte aligned so readers can use the mapped entries in place
+        const size_t pad = align_up(file_off_, alignof(uint64_t)) - file_off_;
+        const size_t bytes = index_.size() * sizeof(BlockIndexEntry);
+        ensure_chunk(pad + bytes);
+        std::memset(map_base_ + file_off_, 0, pad);
+        file_off_ += pad;
+        std::memcpy(map_base_ + file_off_, index_.data(), bytes);
+        header_.index_off = file_off_;
+        header_.index_version = BLOCK_INDEX_VERSION;
+        file_off_ += bytes;
+    }
+
     void flush_block() {
         if (!is_open() || buf_.empty()) {
             return;
@@ -283,3 +328,10 @@ private:
         ::fdatasync(fd_);
     }
 };
+
+// L2TBlockCodec<L2Schema> works too, but scales timestamps to ms, the schema codec keeps them in ns
+using L2BlockWriter = BlockWriterT<L2Schema, SchemaBlockCodec<L2Schema>>;
+using L3BlockWriter = BlockWriterT<L3Schema, L3BlockCodec<L3Schema>>;
+using ImbalanceBlockWriter = BlockWriterT<ImbalanceSchema, SchemaBlockCodec<ImbalanceSchema>>;
+using VwapBlockWriter = BlockWriterT<VwapSchema, SchemaBlockCodec<VwapSchema>>;
+using VoiBlockWriter = BlockWriterT<VoiSchema, SchemaBlockCodec<VoiSchema>>;
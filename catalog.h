@@ -0,0 +1,338 @@
+#pragma once
+#include <cerrno>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "block_format.h"
+#include "checksum.h"
+
+// per product directory catalog of day files, kept up to date by the writers and mmapped by the readers,
+// so planning a backtest knows days, rows and ts ranges without listing the directory or opening a data file.
+// writers upsert a day when they open its file (flagged CATALOG_DAY_OPEN) and again with the totals on close.
+// a catalog first created in a directory that already holds day files is not CATALOG_COMPLETE, readers scan the
+// directory for it until rebuild_catalog has backfilled the older days. deleting or adding day files by hand also
+// needs a rebuild_catalog
+//
+// layout: [CatalogHeader][CatalogEntry x n_entries], entries sorted by yyyymmdd
+// updates go to catalog.idx.tmp and are renamed over catalog.idx under an flock, readers that already
+// mapped the old file keep a consistent snapshot
+
+enum class CatalogCodec : uint8_t {
+    COLUMNS = 0, // WriterT .bin, ColFileHeaderT + raw columns
+    BLOCKS = 1, // BlockWriterT .blocks
+};
+
+static constexpr uint32_t CATALOG_VERSION = 2;
+
+// CatalogHeader::flags
+static constexpr uint32_t CATALOG_COMPLETE = 1; // every day file of the directory has an entry
+
+// CatalogEntry::flags
+static constexpr uint8_t CATALOG_DAY_OPEN = 1; // file opened by a writer and not closed yet, rows and ranges not final
+
+#pragma pack(push, 1)
+struct CatalogHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t n_entries;
+    uint64_t generation; // bumped on every update
+    uint32_t flags;
+    uint32_t reserved0;
+};
+
+struct CatalogEntry {
+    uint32_t yyyymmdd;
+    uint16_t schema_version;
+    uint8_t codec; // CatalogCodec
+    uint8_t flags;
+    uint16_t codec_version; // Codec::VERSION for block files, 0 for raw columns
+    uint16_t reserved1;
+    uint32_t content_crc; // crc32c over the used column bytes, over the block crcs for block files, 0 = unknown
+    uint64_t rows;
+    uint64_t bytes;
+    uint64_t min_ts;
+    uint64_t max_ts;
+    char file[32]; // file name inside the product directory
+};
+#pragma pack(pop)
+
+class DayCatalog {
+public:
+    static constexpr char MAGIC[8] = {'D', 'A', 'Y', 'C', 'A', 'T', '\n', '\0'};
+    static constexpr const char* FILE_NAME = "catalog.idx";
+
+    explicit DayCatalog(const std::filesystem::path& dir) { map(dir / FILE_NAME); }
+    ~DayCatalog() { unmap(); }
+
+    DayCatalog(const DayCatalog&) = delete;
+    DayCatalog& operator=(const DayCatalog&) = delete;
+
+    bool valid() const noexcept { return entries_ != nullptr || (base_ && n_ == 0); }
+    size_t size() const noexcept { return n_; }
+    const CatalogEntry* begin() const noexcept { return entries_; }
+    const CatalogEntry* end() const noexcept { return entries_ + n_; }
+    uint64_t generation() const noexcept { return generation_; }
+    // a complete catalog lists every day of the directory, readers plan from it alone
+    bool complete() const noexcept { return valid() && (flags_ & CATALOG_COMPLETE); }
+
+    // entry for yyyymmdd when it is recorded for file (a name inside the product directory), null otherwise
+    const CatalogEntry* find(uint32_t yyyymmdd, const std::string& file) const noexcept {
+        const CatalogEntry* it = std::lower_bound(begin(), end(), yyyymmdd,
+                                                  [](const CatalogEntry& a, uint32_t d) { return a.yyyymmdd < d; });
+        if (it == end() || it->yyyymmdd != yyyymmdd || file.size() >= sizeof(it->file) ||
+            std::strncmp(it->file, file.c_str(), sizeof(it->file)) != 0) {
+            return nullptr;
+        }
+        return it;
+    }
+
+    // inserts or replaces the entry for e.yyyymmdd, false when the catalog could not be written. creating the
+    // catalog looks once for other day files next to e.file, it is only complete when there are none
+    static bool upsert(const std::filesystem::path& dir, const CatalogEntry& e) {
+        const int lock_fd = lock(dir);
+        if (lock_fd < 0) {
+            return false;
+        }
+
+        std::vector<CatalogEntry> entries;
+        uint64_t generation = 0;
+        uint32_t flags = 0;
+        {
+            DayCatalog curr(dir);
+            if (curr.valid()) {
+                entries.assign(curr.begin(), curr.end());
+                generation = curr.generation();
+                flags = curr.flags_;
+            }
+            else if (!other_days(dir, e.file)) {
+                flags = CATALOG_COMPLETE;
+            }
+        }
+
+        auto it = std::lower_bound(entries.begin(), entries.end(), e.yyyymmdd,
+                                   [](const CatalogEntry& a, uint32_t d) { return a.yyyymmdd < d; });
+        if (it != entries.end() && it->yyyymmdd == e.yyyymmdd) {
+            *it = e;
+        }
+        else {
+            entries.insert(it, e);
+        }
+
+        const bool ok = write_atomic(dir, entries, generation + 1, flags);
+        return unlock(lock_fd) && ok;
+    }
+
+    // rebuilds the catalog from a scan of the directory and marks it complete. scanned holds an entry for every day
+    // file on disk, the entry the writers recorded for a day wins over the scanned one. days no longer on disk are
+    // dropped unless a writer has them open (the scan may have run before the file was created)
+    static bool backfill(const std::filesystem::path& dir, std::vector<CatalogEntry> scanned) {
+        const int lock_fd = lock(dir);
+        if (lock_fd < 0) {
+            return false;
+        }
+        uint64_t generation = 0;
+        std::vector<CatalogEntry> entries;
+        {
+            DayCatalog curr(dir);
+            generation = curr.generation();
+            std::sort(scanned.begin(), scanned.end(),
+                      [](const CatalogEntry& a, const CatalogEntry& b) { return a.yyyymmdd < b.yyyymmdd; });
+            for (const CatalogEntry& e : scanned) {
+                const CatalogEntry* known = curr.find(e.yyyymmdd, file_name(e));
+                entries.push_back(known ? *known : e);
+            }
+            for (const CatalogEntry& c : curr) {
+                const bool on_disk = std::binary_search(
+                    scanned.begin(), scanned.end(), c,
+                    [](const CatalogEntry& a, const CatalogEntry& b) { return a.yyyymmdd < b.yyyymmdd; });
+                if (!on_disk && (c.flags & CATALOG_DAY_OPEN)) {
+                    entries.push_back(c);
+                }
+            }
+        }
+        std::sort(entries.begin(), entries.end(),
+                  [](const CatalogEntry& a, const CatalogEntry& b) { return a.yyyymmdd < b.yyyymmdd; });
+        const bool ok = write_atomic(dir, entries, generation + 1, CATALOG_COMPLETE);
+        return unlock(lock_fd) && ok;
+    }
+
+    static CatalogEntry make_entry(uint32_t yyyymmdd, const std::string& file, CatalogCodec codec,
+                                   uint16_t codec_version, uint16_t schema_version, uint64_t rows, uint64_t bytes,
+                                   uint64_t min_ts, uint64_t max_ts, uint32_t content_crc = 0, uint8_t flags = 0) {
+        CatalogEntry e{};
+        e.yyyymmdd = yyyymmdd;
+        e.flags = flags;
+        e.schema_version = schema_version;
+        e.codec = static_cast<uint8_t>(codec);
+        e.codec_version = codec_version;
+        e.rows = rows;
+        e.bytes = bytes;
+        e.min_ts = min_ts;
+        e.max_ts = max_ts;
+        e.content_crc = content_crc;
+        std::snprintf(e.file, sizeof(e.file), "%s", file.c_str());
+        return e;
+    }
+
+    // closed .blocks file, ts range from the block zone maps and the content crc over the block crcs
+    static CatalogEntry blocks_entry(uint32_t yyyymmdd, const std::string& file, uint16_t codec_version,
+                                     uint16_t schema_version, uint64_t rows, uint64_t bytes,
+                                     const BlockIndexEntry* index, size_t n_blocks) {
+        uint64_t min_ts = ~0ull;
+        uint64_t max_ts = 0;
+        uint32_t crc = 0;
+        for (size_t k = 0; k < n_blocks; ++k) {
+            const BlockIndexEntry& e = index[k];
+            crc = Crc32c::compute(&e.crc, sizeof(e.crc), crc);
+            if (e.rows) {
+                min_ts = std::min(min_ts, e.stats.min_ts);
+                max_ts = std::max(max_ts, e.stats.max_ts);
+            }
+        }
+        if (min_ts > max_ts) {
+            min_ts = max_ts = 0;
+        }
+        return make_entry(yyyymmdd, file, CatalogCodec::BLOCKS, codec_version, schema_version, rows, bytes, min_ts,
+                          max_ts, crc);
+    }
+
+    static bool write_atomic(const std::filesystem::path& dir, const std::vector<CatalogEntry>& entries,
+                             uint64_t generation, uint32_t flags) {
+        const std::filesystem::path final_path = dir / FILE_NAME;
+        const std::filesystem::path tmp_path = dir / (std::string(FILE_NAME) + ".tmp");
+
+        CatalogHeader hdr{};
+        std::memcpy(hdr.magic, MAGIC, sizeof(MAGIC));
+        hdr.version = CATALOG_VERSION;
+        hdr.n_entries = static_cast<uint32_t>(entries.size());
+        hdr.generation = generation;
+        hdr.flags = flags;
+
+        const int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        const size_t body = entries.size() * sizeof(CatalogEntry);
+        bool ok = ::write(fd, &hdr, sizeof(hdr)) == static_cast<ssize_t>(sizeof(hdr));
+        ok = ok && (body == 0 || ::write(fd, entries.data(), body) == static_cast<ssize_t>(body));
+        ok = ok && ::fdatasync(fd) == 0;
+        ::close(fd);
+        if (!ok || ::rename(tmp_path.c_str(), final_path.c_str()) != 0) {
+            ::unlink(tmp_path.c_str());
+            return false;
+        }
+        // the rename only survives a crash once the directory entry is on disk
+        const int dir_fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dir_fd < 0) {
+            return false;
+        }
+        ok = ::fsync(dir_fd) == 0;
+        ::close(dir_fd);
+        return ok;
+    }
+
+    // file name of e, empty when the field is not terminated
+    static std::string file_name(const CatalogEntry& e) {
+        const size_t n = ::strnlen(e.file, sizeof(e.file));
+        return n < sizeof(e.file) ? std::string(e.file, n) : std::string{};
+    }
+
+private:
+    // any file in dir named like a day file (8 digits and the extension of file) other than file itself
+    static bool other_days(const std::filesystem::path& dir, const char* file) {
+        const std::string self(file, ::strnlen(file, sizeof(CatalogEntry::file)));
+        const std::string ext = self.size() > 8 ? self.substr(8) : std::string{};
+        std::error_code ec;
+        for (std::filesystem::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+            const std::string name = it->path().filename().string();
+            if (name != self && name.size() == 8 + ext.size() && name.compare(8, std::string::npos, ext) == 0 &&
+                std::all_of(name.begin(), name.begin() + 8, [](char c) { return c >= '0' && c <= '9'; })) {
+                return true;
+            }
+        }
+        return ec.value() != 0; // can't tell, stay incomplete
+    }
+
+    // exclusive lock serialising writers of dir's catalog, the lock fd or -1
+    static int lock(const std::filesystem::path& dir) {
+        const std::filesystem::path lock_path = dir / (std::string(FILE_NAME) + ".lock");
+        const int fd = ::open(lock_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return -1;
+        }
+        int rc;
+        do {
+            rc = ::flock(fd, LOCK_EX);
+        } while (rc != 0 && errno == EINTR);
+        if (rc != 0) {
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    static bool unlock(int fd) {
+        const bool ok = ::flock(fd, LOCK_UN) == 0;
+        return ::close(fd) == 0 && ok;
+    }
+
+    void map(const std::filesystem::path& p) {
+        const int fd = ::open(p.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st{};
+        if (::fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(CatalogHeader))) {
+            ::close(fd);
+            return;
+        }
+        map_bytes_ = static_cast<size_t>(st.st_size);
+        void* m = ::mmap(nullptr, map_bytes_, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (m == MAP_FAILED) {
+            map_bytes_ = 0;
+            return;
+        }
+        base_ = static_cast<const uint8_t*>(m);
+
+        CatalogHeader hdr{};
+        std::memcpy(&hdr, base_, sizeof(hdr));
+        if (std::memcmp(hdr.magic, MAGIC, sizeof(MAGIC)) != 0 || hdr.version != CATALOG_VERSION ||
+            sizeof(CatalogHeader) + static_cast<size_t>(hdr.n_entries) * sizeof(CatalogEntry) > map_bytes_) {
+            unmap();
+            return;
+        }
+        n_ = hdr.n_entries;
+        generation_ = hdr.generation;
+        flags_ = hdr.flags;
+        entries_ = n_ ? reinterpret_cast<const CatalogEntry*>(base_ + sizeof(CatalogHeader)) : nullptr;
+    }
+
+    void unmap() {
+        if (base_) {
+            ::munmap(const_cast<uint8_t*>(base_), map_bytes_);
+        }
+        base_ = nullptr;
+        entries_ = nullptr;
+        map_bytes_ = 0;
+        n_ = 0;
+        flags_ = 0;
+    }
+
+    const uint8_t* base_{nullptr};
+    size_t map_bytes_{0};
+    const CatalogEntry* entries_{nullptr};
+    size_t n_{0};
+    uint64_t generation_{0};
+    uint32_t flags_{0};
+};
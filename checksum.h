@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
+
+// crc32c (castagnoli), hardware crc32 instruction when built with sse4.2, table driven otherwise
+struct Crc32c {
+    static constexpr uint32_t POLY = 0x82f63b78u; // reflected
+
+    static const uint32_t* table() {
+        static const struct Table {
+            uint32_t t[256];
+
+            Table() {
+                for (uint32_t i = 0; i < 256; ++i) {
+                    uint32_t c = i;
+                    for (int k = 0; k < 8; ++k) {
+                        c = (c & 1) ? (c >> 1) ^ POLY : c >> 1;
+                    }
+                    t[i] = c;
+                }
+            }
+        } tbl;
+        return tbl.t;
+    }
+
+    static uint32_t compute(const void* data, size_t len, uint32_t seed = 0) {
+        const auto* p = static_cast<const uint8_t*>(data);
+        uint32_t crc = ~seed;
+#if defined(__SSE4_2__)
+        uint64_t c64 = crc;
+        for (; len >= 8; len -= 8, p += 8) {
+            uint64_t v;
+            std::memcpy(&v, p, sizeof(v));
+            c64 = _mm_crc32_u64(c64, v);
+        }
+        crc = static_cast<uint32_t>(c64);
+        for (; len > 0; --len, ++p) {
+            crc = _mm_crc32_u8(crc, *p);
+        }
+#else
+        const uint32_t* t = table();
+        for (; len > 0; --len, ++p) {
+            crc = t[(crc ^ *p) & 0xffu] ^ (crc >> 8);
+        }
+#endif
+        return ~crc;
+    }
+};
@@ -0,0 +1,612 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include <stdexcept>
+#include "bitpack.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// per block encodings for integer columns, the chosen one is stored as a tag in the block header
+enum class ColEnc : uint8_t {
+    RAW = 0,
+    CONST = 1, // every row holds the same value
+    FOR = 2, // frame of reference, value - min bitpacked
+    DELTA = 3, // row to row delta, zigzag + bitpacked
+    RLE = 4, // (value - min, run length - 1) pairs, both bitpacked
+    DICT = 5, // up to MAX_DICT distinct values, bitpacked indices
+    DELTA_FOR = 6, // row to row delta, frame of reference + bitpacked per MINIBLOCK deltas
+    STRIDE = 7, // constant row to row stride, deltas that differ stored as (index, zigzag delta) exceptions
+};
+
+struct ColCodec : BitPack {
+    // bitunpack_u64 refills a 64 bit accumulator a byte at a time, wider values would lose their top bits
+    static constexpr uint32_t MAX_BW = 56;
+    static constexpr uint32_t MAX_DICT = 256;
+    static constexpr uint32_t MINIBLOCK = 128;
+
+#pragma pack(push, 1)
+    struct ForHeader {
+        uint64_t base;
+        uint8_t bw;
+    };
+
+    struct DeltaHeader {
+        uint64_t first;
+        uint8_t bw;
+    };
+
+    struct RleHeader {
+        uint32_t runs;
+        uint64_t base;
+        uint8_t val_bw;
+        uint8_t len_bw;
+    };
+
+    struct DictHeader {
+        uint16_t k;
+        uint8_t bw;
+    };
+
+    struct StrideHeader {
+        uint64_t first;
+        uint64_t stride;
+        uint32_t n_exc;
+        uint8_t idx_bw;
+        uint8_t val_bw;
+    };
+#pragma pack(pop)
+
+    // bits needed to hold max_v, 64 for values with the top bit set (max_v + 1 would wrap to 0)
+    static inline uint32_t bw_of(uint64_t max_v) {
+        return max_v ? 64u - static_cast<uint32_t>(__builtin_clzll(max_v)) : 0u;
+    }
+
+    static inline size_t packed_bytes(size_t n, uint32_t bw) {
+        return (n * bw + 7) / 8;
+    }
+
+    struct Stats {
+        uint64_t min{~0ull};
+        uint64_t max{0};
+        uint64_t max_dz{0};
+        uint64_t max_run{0};
+        uint32_t runs{0};
+        uint32_t distinct{0}; // MAX_DICT + 1 when there are too many to dictionary encode
+        size_t delta_for_bytes{0};
+        uint32_t delta_for_bw{0};
+        uint64_t stride{0}; // majority row to row delta
+        uint32_t stride_exc{0};
+        uint64_t max_exc_dz{0};
+    };
+
+    static inline size_t varint_len(uint64_t v) {
+        size_t len = 1;
+        while (v >= 0x80) {
+            v >>= 7;
+            ++len;
+        }
+        return len;
+    }
+
+    static inline void put_varint(uint64_t v, std::vector<uint8_t>& out) {
+        while (v >= 0x80) {
+            out.push_back(static_cast<uint8_t>(v | 0x80));
+            v >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(v));
+    }
+
+    static inline uint64_t get_varint(const uint8_t* src, size_t len, size_t& off) {
+        uint64_t v = 0;
+        for (uint32_t shift = 0; shift < 64; shift += 7) {
+            if (off >= len) {
+                throw std::runtime_error("[colcodec] varint truncated");
+            }
+            const uint8_t b = src[off++];
+            v |= static_cast<uint64_t>(b & 0x7f) << shift;
+            if ((b & 0x80) == 0) {
+                return v;
+            }
+        }
+        throw std::runtime_error("[colcodec] varint too long");
+    }
+
+    // miniblock layout: [bw:u8][zigzag(min delta):varint][bitpacked delta - min]
+    static inline size_t miniblock_bytes(int64_t mn, int64_t mx, size_t cnt, uint32_t& bw) {
+        bw = bw_of(static_cast<uint64_t>(mx) - static_cast<uint64_t>(mn));
+        return 1 + varint_len(zigzag_enc64(mn)) + packed_bytes(cnt, bw);
+    }
+
+    static const uint8_t* read_miniblock(const uint8_t* src, size_t len, size_t& off, size_t cnt,
+                                         uint32_t& bw, int64_t& mn) {
+        if (off >= len) {
+            throw std::runtime_error("[colcodec] DELTA_FOR miniblock truncated");
+        }
+        bw = src[off++];
+        mn = zigzag_dec64(get_varint(src, len, off));
+        const size_t bytes = packed_bytes(cnt, bw);
+        if (bw > MAX_BW || len - off < bytes) {
+            throw std::runtime_error("[colcodec] DELTA_FOR miniblock truncated");
+        }
+        const uint8_t* p = src + off;
+        off += bytes;
+        return p;
+    }
+
+    // inclusive prefix sum with wrap around, 4 lanes at a time: x += x << 1 lane, x += x << 2 lanes, x += carry
+    static inline void prefix_sum_u32(uint32_t* v, size_t n) {
+        size_t i = 0;
+        uint32_t acc = 0;
+#if defined(__SSE2__)
+        __m128i carry = _mm_setzero_si128();
+        for (; i + 4 <= n; i += 4) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i));
+            x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+            x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+            x = _mm_add_epi32(x, carry);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(v + i), x);
+            carry = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+        }
+        acc = static_cast<uint32_t>(_mm_cvtsi128_si32(carry));
+#endif
+        for (; i < n; ++i) {
+            acc += v[i];
+            v[i] = acc;
+        }
+    }
+
+    static Stats scan(const uint64_t* vals, size_t n, std::vector<uint64_t>& scratch) {
+        Stats st{};
+        uint64_t run = 0;
+        int64_t mb_min = std::numeric_limits<int64_t>::max();
+        int64_t mb_max = std::numeric_limits<int64_t>::min();
+        size_t mb_cnt = 0;
+        uint32_t votes = 0;
+        auto flush_miniblock = [&]() {
+            if (mb_cnt == 0) {
+                return;
+            }
+            uint32_t bw;
+            st.delta_for_bytes += miniblock_bytes(mb_min, mb_max, mb_cnt, bw);
+            st.delta_for_bw = bw > st.delta_for_bw ? bw : st.delta_for_bw;
+            mb_min = std::numeric_limits<int64_t>::max();
+            mb_max = std::numeric_limits<int64_t>::min();
+            mb_cnt = 0;
+        };
+
+        for (size_t i = 0; i < n; ++i) {
+            const uint64_t v = vals[i];
+            st.min = v < st.min ? v : st.min;
+            st.max = v > st.max ? v : st.max;
+            if (i > 0) {
+                const int64_t d = static_cast<int64_t>(v - vals[i - 1]);
+                const uint64_t dz = zigzag_enc64(d);
+                st.max_dz = dz > st.max_dz ? dz : st.max_dz;
+                mb_min = d < mb_min ? d : mb_min;
+                mb_max = d > mb_max ? d : mb_max;
+                if (++mb_cnt == MINIBLOCK) {
+                    flush_miniblock();
+                }
+                // boyer moore majority vote for the stride
+                if (votes == 0) {
+                    st.stride = static_cast<uint64_t>(d);
+                    votes = 1;
+                }
+                else if (st.stride == static_cast<uint64_t>(d)) {
+                    ++votes;
+                }
+                else {
+                    --votes;
+                }
+            }
+            if (i == 0 || v != vals[i - 1]) {
+                st.max_run = run > st.max_run ? run : st.max_run;
+                st.runs++;
+                run = 1;
+            }
+            else {
+                ++run;
+            }
+        }
+        st.max_run = run > st.max_run ? run : st.max_run;
+        flush_miniblock();
+
+        for (size_t i = 1; i < n; ++i) {
+            const uint64_t d = vals[i] - vals[i - 1];
+            if (d != st.stride) {
+                const uint64_t dz = zigzag_enc64(static_cast<int64_t>(d));
+                st.max_exc_dz = dz > st.max_exc_dz ? dz : st.max_exc_dz;
+                st.stride_exc++;
+            }
+        }
+
+        if (st.runs <= 1) {
+            st.distinct = st.runs;
+            return st;
+        }
+        scratch.assign(vals, vals + n);
+        std::sort(scratch.begin(), scratch.end());
+        st.distinct = static_cast<uint32_t>(std::unique(scratch.begin(), scratch.end()) - scratch.begin());
+        if (st.distinct > MAX_DICT) {
+            st.distinct = MAX_DICT + 1;
+        }
+        return st;
+    }
+
+    // exact payload size of each candidate, computed from the stats instead of encoding every one
+    static ColEnc choose(const Stats& st, size_t n, uint32_t width) {
+        ColEnc best = ColEnc::RAW;
+        size_t best_len = n * width;
+        auto consider = [&](ColEnc e, size_t len, uint32_t bw) {
+            if (bw <= MAX_BW && len < best_len) {
+                best = e;
+                best_len = len;
+            }
+        };
+
+        if (st.runs == 1) {
+            return ColEnc::CONST;
+        }
+
+        const uint32_t for_bw = bw_of(st.max - st.min);
+        consider(ColEnc::FOR, sizeof(ForHeader) + packed_bytes(n, for_bw), for_bw);
+
+        const uint32_t d_bw = bw_of(st.max_dz);
+        consider(ColEnc::DELTA, sizeof(DeltaHeader) + packed_bytes(n - 1, d_bw), d_bw);
+        consider(ColEnc::DELTA_FOR, sizeof(uint64_t) + st.delta_for_bytes, st.delta_for_bw);
+
+        const uint32_t idx_bw = bw_of(n - 1);
+        const uint32_t exc_bw = bw_of(st.max_exc_dz);
+        consider(ColEnc::STRIDE,
+                 sizeof(StrideHeader) + packed_bytes(st.stride_exc, idx_bw) + packed_bytes(st.stride_exc, exc_bw),
+                 std::max(idx_bw, exc_bw));
+
+        const uint32_t len_bw = bw_of(st.max_run - 1);
+        consider(ColEnc::RLE, sizeof(RleHeader) + packed_bytes(st.runs, for_bw) + packed_bytes(st.runs, len_bw),
+                 std::max(for_bw, len_bw));
+
+        if (st.distinct <= MAX_DICT) {
+            const uint32_t k_bw = bw_of(st.distinct - 1);
+            consider(ColEnc::DICT, sizeof(DictHeader) + st.distinct * width + packed_bytes(n, k_bw), k_bw);
+        }
+        return best;
+    }
+
+    template <class H>
+    static void put_header(const H& h, std::vector<uint8_t>& out) {
+        const size_t before = out.size();
+        out.resize(before + sizeof(H));
+        std::memcpy(out.data() + before, &h, sizeof(H));
+    }
+
+    template <class H>
+    static H get_header(const uint8_t* src, size_t len) {
+        if (len < sizeof(H)) {
+            throw std::runtime_error("[colcodec] column header truncated");
+        }
+        H h{};
+        std::memcpy(&h, src, sizeof(H));
+        return h;
+    }
+
+    // width is the in memory size of the column type, only used by RAW and DICT
+    static ColEnc encode(const uint64_t* vals, size_t n, uint32_t width, std::vector<uint8_t>& out) {
+        if (n == 0) {
+            return ColEnc::RAW;
+        }
+
+        std::vector<uint64_t> scratch;
+        const Stats st = scan(vals, n, scratch);
+        const ColEnc enc = choose(st, n, width);
+
+        switch (enc) {
+        case ColEnc::CONST: {
+            put_header(vals[0], out);
+            break;
+        }
+        case ColEnc::FOR: {
+            ForHeader h{st.min, static_cast<uint8_t>(bw_of(st.max - st.min))};
+            put_header(h, out);
+            scratch.resize(n);
+            for (size_t i = 0; i < n; ++i) {
+                scratch[i] = vals[i] - st.min;
+            }
+            bitpack_u64(scratch.data(), n, h.bw, out);
+            break;
+        }
+        case ColEnc::DELTA: {
+            DeltaHeader h{vals[0], static_cast<uint8_t>(bw_of(st.max_dz))};
+            put_header(h, out);
+            scratch.resize(n);
+            for (size_t i = 1; i < n; ++i) {
+                scratch[i - 1] = zigzag_enc64(static_cast<int64_t>(vals[i] - vals[i - 1]));
+            }
+            bitpack_u64(scratch.data(), n - 1, h.bw, out);
+            break;
+        }
+        case ColEnc::DELTA_FOR: {
+            put_header(vals[0], out);
+            scratch.resize(MINIBLOCK);
+            for (size_t b = 1; b < n; b += MINIBLOCK) {
+                const size_t cnt = std::min<size_t>(MINIBLOCK, n - b);
+                int64_t mn = std::numeric_limits<int64_t>::max();
+                int64_t mx = std::numeric_limits<int64_t>::min();
+                for (size_t k = 0; k < cnt; ++k) {
+                    const int64_t d = static_cast<int64_t>(vals[b + k] - vals[b + k - 1]);
+                    scratch[k] = static_cast<uint64_t>(d);
+                    mn = d < mn ? d : mn;
+                    mx = d > mx ? d : mx;
+                }
+                uint32_t bw;
+                miniblock_bytes(mn, mx, cnt, bw);
+                out.push_back(static_cast<uint8_t>(bw));
+                put_varint(zigzag_enc64(mn), out);
+                for (size_t k = 0; k < cnt; ++k) {
+                    scratch[k] -= static_cast<uint64_t>(mn);
+                }
+                bitpack_u64(scratch.data(), cnt, bw, out);
+            }
+            break;
+        }
+        case ColEnc::STRIDE: {
+            StrideHeader h{vals[0], st.stride, st.stride_exc, static_cast<uint8_t>(bw_of(n - 1)),
+                           static_cast<uint8_t>(bw_of(st.max_exc_dz))};
+            put_header(h, out);
+            scratch.resize(2 * static_cast<size_t>(st.stride_exc));
+            uint64_t* exc_idx = scratch.data();
+            uint64_t* exc_val = scratch.data() + st.stride_exc;
+            size_t e = 0;
+            for (size_t i = 1; i < n; ++i) {
+                const uint64_t d = vals[i] - vals[i - 1];
+                if (d != st.stride) {
+                    exc_idx[e] = i;
+                    exc_val[e] = zigzag_enc64(static_cast<int64_t>(d));
+                    ++e;
+                }
+            }
+            bitpack_u64(exc_idx, st.stride_exc, h.idx_bw, out);
+            bitpack_u64(exc_val, st.stride_exc, h.val_bw, out);
+            break;
+        }
+        case ColEnc::RLE: {
+            RleHeader h{st.runs, st.min, static_cast<uint8_t>(bw_of(st.max - st.min)),
+                        static_cast<uint8_t>(bw_of(st.max_run - 1))};
+            put_header(h, out);
+            scratch.resize(2 * static_cast<size_t>(st.runs));
+            uint64_t* run_val = scratch.data();
+            uint64_t* run_len = scratch.data() + st.runs;
+            size_t r = 0;
+            for (size_t i = 0; i < n; ++r) {
+                size_t j = i + 1;
+                while (j < n && vals[j] == vals[i]) {
+                    ++j;
+                }
+                run_val[r] = vals[i] - st.min;
+                run_len[r] = j - i - 1;
+                i = j;
+            }
+            bitpack_u64(run_val, st.runs, h.val_bw, out);
+            bitpack_u64(run_len, st.runs, h.len_bw, out);
+            break;
+        }
+        case ColEnc::DICT: {
+            // scan() left the sorted distinct values at the front of scratch
+            DictHeader h{static_cast<uint16_t>(st.distinct), static_cast<uint8_t>(bw_of(st.distinct - 1))};
+            put_header(h, out);
+            const size_t before = out.size();
+            out.resize(before + static_cast<size_t>(st.distinct) * width);
+            for (uint32_t k = 0; k < st.distinct; ++k) {
+                std::memcpy(out.data() + before + k * width, &scratch[k], width);
+            }
+            std::vector<uint64_t> idx(n);
+            for (size_t i = 0; i < n; ++i) {
+                idx[i] = static_cast<uint64_t>(
+                    std::lower_bound(scratch.begin(), scratch.begin() + st.distinct, vals[i]) - scratch.begin());
+            }
+            bitpack_u64(idx.data(), n, h.bw, out);
+            break;
+        }
+        case ColEnc::RAW: {
+            const size_t before = out.size();
+            out.resize(before + n * width);
+            for (size_t i = 0; i < n; ++i) {
+                std::memcpy(out.data() + before + i * width, &vals[i], width);
+            }
+            break;
+        }
+        }
+        return enc;
+    }
+
+    static void decode(ColEnc enc, const uint8_t* src, size_t len, size_t n, uint32_t width, uint64_t* out) {
+        if (n == 0) {
+            return;
+        }
+
+        switch (enc) {
+        case ColEnc::CONST: {
+            const uint64_t v = get_header<uint64_t>(src, len);
+            std::fill(out, out + n, v);
+            return;
+        }
+        case ColEnc::FOR: {
+            const ForHeader h = get_header<ForHeader>(src, len);
+            if (h.bw > MAX_BW || len - sizeof(ForHeader) < packed_bytes(n, h.bw)) {
+                throw std::runtime_error("[colcodec] FOR column truncated");
+            }
+            bitunpack_u64(src + sizeof(ForHeader), n, h.bw, out);
+            for (size_t i = 0; i < n; ++i) {
+                out[i] += h.base;
+            }
+            return;
+        }
+        case ColEnc::DELTA: {
+            const DeltaHeader h = get_header<DeltaHeader>(src, len);
+            if (h.bw > MAX_BW || len - sizeof(DeltaHeader) < packed_bytes(n - 1, h.bw)) {
+                throw std::runtime_error("[colcodec] DELTA column truncated");
+            }
+            bitunpack_u64(src + sizeof(DeltaHeader), n - 1, h.bw, out + 1);
+            out[0] = h.first;
+            for (size_t i = 1; i < n; ++i) {
+                out[i] = out[i - 1] + static_cast<uint64_t>(zigzag_dec64(out[i]));
+            }
+            return;
+        }
+        case ColEnc::DELTA_FOR: {
+            out[0] = get_header<uint64_t>(src, len);
+            size_t off = sizeof(uint64_t);
+            for (size_t b = 1; b < n; b += MINIBLOCK) {
+                const size_t cnt = std::min<size_t>(MINIBLOCK, n - b);
+                uint32_t bw;
+                int64_t mn;
+                const uint8_t* p = read_miniblock(src, len, off, cnt, bw, mn);
+                bitunpack_u64(p, cnt, bw, out + b);
+                for (size_t k = 0; k < cnt; ++k) {
+                    out[b + k] += out[b + k - 1] + static_cast<uint64_t>(mn);
+                }
+            }
+            return;
+        }
+        case ColEnc::STRIDE: {
+            const StrideHeader h = get_header<StrideHeader>(src, len);
+            const size_t idx_bytes = packed_bytes(h.n_exc, h.idx_bw);
+            if (h.idx_bw > MAX_BW || h.val_bw > MAX_BW || h.n_exc >= n ||
+                len - sizeof(StrideHeader) < idx_bytes + packed_bytes(h.n_exc, h.val_bw)) {
+                throw std::runtime_error("[colcodec] STRIDE column truncated");
+            }
+            std::vector<uint64_t> exc(2 * static_cast<size_t>(h.n_exc));
+            bitunpack_u64(src + sizeof(StrideHeader), h.n_exc, h.idx_bw, exc.data());
+            bitunpack_u64(src + sizeof(StrideHeader) + idx_bytes, h.n_exc, h.val_bw, exc.data() + h.n_exc);
+            std::fill(out + 1, out + n, h.stride);
+            for (uint32_t e = 0; e < h.n_exc; ++e) {
+                if (exc[e] == 0 || exc[e] >= n) {
+                    throw std::runtime_error("[colcodec] STRIDE exception out of range");
+                }
+                out[exc[e]] = static_cast<uint64_t>(zigzag_dec64(exc[h.n_exc + e]));
+            }
+            out[0] = h.first;
+            for (size_t i = 1; i < n; ++i) {
+                out[i] += out[i - 1];
+            }
+            return;
+        }
+        case ColEnc::RLE: {
+            const RleHeader h = get_header<RleHeader>(src, len);
+            const size_t val_bytes = packed_bytes(h.runs, h.val_bw);
+            if (h.val_bw > MAX_BW || h.len_bw > MAX_BW ||
+                len - sizeof(RleHeader) < val_bytes + packed_bytes(h.runs, h.len_bw)) {
+                throw std::runtime_error("[colcodec] RLE column truncated");
+            }
+            std::vector<uint64_t> runs(2 * static_cast<size_t>(h.runs));
+            bitunpack_u64(src + sizeof(RleHeader), h.runs, h.val_bw, runs.data());
+            bitunpack_u64(src + sizeof(RleHeader) + val_bytes, h.runs, h.len_bw, runs.data() + h.runs);
+            size_t i = 0;
+            for (uint32_t r = 0; r < h.runs; ++r) {
+                const size_t run = runs[h.runs + r] + 1;
+                if (i + run > n) {
+                    throw std::runtime_error("[colcodec] RLE runs exceed block rows");
+                }
+                std::fill(out + i, out + i + run, runs[r] + h.base);
+                i += run;
+            }
+            if (i != n) {
+                throw std::runtime_error("[colcodec] RLE runs short of block rows");
+            }
+            return;
+        }
+        case ColEnc::DICT: {
+            const DictHeader h = get_header<DictHeader>(src, len);
+            if (h.k == 0 || h.k > MAX_DICT || h.bw > bw_of(h.k - 1u)) {
+                throw std::runtime_error("[colcodec] DICT header corrupt");
+            }
+            const size_t dict_bytes = static_cast<size_t>(h.k) * width;
+            if (len - sizeof(DictHeader) < dict_bytes + packed_bytes(n, h.bw)) {
+                throw std::runtime_error("[colcodec] DICT column truncated");
+            }
+            uint64_t dict[MAX_DICT]{};
+            const uint8_t* p = src + sizeof(DictHeader);
+            for (uint32_t k = 0; k < h.k; ++k) {
+                std::memcpy(&dict[k], p + k * width, width);
+            }
+            bitunpack_u64(p + dict_bytes, n, h.bw, out);
+            for (size_t i = 0; i < n; ++i) {
+                if (out[i] >= h.k) {
+                    throw std::runtime_error("[colcodec] DICT index out of range");
+                }
+                out[i] = dict[out[i]];
+            }
+            return;
+        }
+        case ColEnc::RAW: {
+            if (len < n * width) {
+                throw std::runtime_error("[colcodec] RAW column truncated");
+            }
+            for (size_t i = 0; i < n; ++i) {
+                out[i] = 0;
+                std::memcpy(&out[i], src + i * width, width);
+            }
+            return;
+        }
+        }
+        throw std::runtime_error("[colcodec] unknown column encoding");
+    }
+
+    // u32 columns (price): deltas are unpacked straight into the output and rebuilt with a simd prefix sum,
+    // anything wider than 32 bits per delta goes through the generic u64 path
+    static void decode_u32(ColEnc enc, const uint8_t* src, size_t len, size_t n, uint32_t* out) {
+        if (n == 0) {
+            return;
+        }
+
+        if (enc == ColEnc::DELTA) {
+            const DeltaHeader h = get_header<DeltaHeader>(src, len);
+            if (h.bw <= 32) {
+                if (len - sizeof(DeltaHeader) < packed_bytes(n - 1, h.bw)) {
+                    throw std::runtime_error("[colcodec] DELTA column truncated");
+                }
+                bitunpack_u32(src + sizeof(DeltaHeader), n - 1, h.bw, out + 1);
+                out[0] = static_cast<uint32_t>(h.first);
+                for (size_t i = 1; i < n; ++i) {
+                    out[i] = static_cast<uint32_t>(zigzag_dec32(out[i]));
+                }
+                prefix_sum_u32(out, n);
+                return;
+            }
+        }
+        else if (enc == ColEnc::DELTA_FOR && decode_delta_for_u32(src, len, n, out)) {
+            return;
+        }
+
+        std::vector<uint64_t> wide(n);
+        decode(enc, src, len, n, sizeof(uint32_t), wide.data());
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = static_cast<uint32_t>(wide[i]);
+        }
+    }
+
+    static bool decode_delta_for_u32(const uint8_t* src, size_t len, size_t n, uint32_t* out) {
+        out[0] = static_cast<uint32_t>(get_header<uint64_t>(src, len));
+        size_t off = sizeof(uint64_t);
+        for (size_t b = 1; b < n; b += MINIBLOCK) {
+            const size_t cnt = std::min<size_t>(MINIBLOCK, n - b);
+            uint32_t bw;
+            int64_t mn;
+            const uint8_t* p = read_miniblock(src, len, off, cnt, bw, mn);
+            if (bw > 32) {
+                return false;
+            }
+            bitunpack_u32(p, cnt, bw, out + b);
+            const uint32_t m = static_cast<uint32_t>(mn);
+            for (size_t k = 0; k < cnt; ++k) {
+                out[b + k] += m;
+            }
+        }
+        prefix_sum_u32(out, n);
+        return true;
+    }
+};
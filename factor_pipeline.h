@@ -0,0 +1,301 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "catalog.h"
+#include "parallel_reader.h"
+#include "writer.h"
+
+struct FactorPipelineOpt {
+    std::string base_dir;
+    std::string input_product;
+    std::string factor_product;
+    uint32_t date_from = 0;
+    uint32_t date_to = 99999999;
+    uint32_t threads{0}; // 0 = hardware_concurrency
+    uint64_t param_hash{0}; // FactorPipelineT::hash_params(params), bump it when the factor code changes
+    uint64_t input_cols{~0ull}; // ReaderOpt::cols, input columns the factor code reads
+};
+
+static constexpr uint32_t FACTOR_MANIFEST_VERSION = 1;
+
+#pragma pack(push, 1)
+struct FactorManifestHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t n_entries;
+};
+
+// what a factor day was computed from, the day is stale as soon as any of it differs
+struct FactorManifestEntry {
+    uint32_t yyyymmdd;
+    uint32_t in_crc; // catalog content crc of the input day, 0 when the input has no catalog
+    uint64_t in_bytes;
+    int64_t in_mtime_ns;
+    uint64_t in_rows;
+    uint64_t param_hash;
+    uint64_t out_rows;
+};
+#pragma pack(pop)
+
+// recomputes only the factor days whose input day or parameters changed since the last run.
+// stale days are replayed on a ParallelReaderT, results go through the ordered reduce into one WriterT<OutSchema>
+// so factor files are still written a day at a time, and the manifest at <base>/<factor product>/factors.manifest
+// is only rewritten once the writer has flushed everything
+template <class InSchema, class OutSchema>
+class FactorPipelineT {
+public:
+    using Segment = typename ReaderT<InSchema>::Segment;
+    using OutRow = typename OutSchema::Row;
+
+    static constexpr char MAGIC[8] = {'F', 'A', 'C', 'M', 'A', 'N', '\n', '\0'};
+    static constexpr const char* FILE_NAME = "factors.manifest";
+
+    explicit FactorPipelineT(const FactorPipelineOpt& opt) : opt_(opt) { load_manifest(); }
+
+    // fnv-1a, zero initialise padded param structs so the hash only sees the values
+    static uint64_t hash_bytes(const void* data, size_t len, uint64_t h = 14695981039346656037ull) {
+        const auto* p = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < len; ++i) {
+            h = (h ^ p[i]) * 1099511628211ull;
+        }
+        return h;
+    }
+
+    template <class Params>
+    static uint64_t hash_params(const Params& p) {
+        static_assert(std::is_trivially_copyable_v<Params>, "[factorpipeline] params must be trivially copyable");
+        return hash_bytes(&p, sizeof(p));
+    }
+
+    static uint64_t hash_params(std::string_view s) { return hash_bytes(s.data(), s.size()); }
+
+    std::vector<uint32_t> stale_days() const {
+        std::vector<uint32_t> out;
+        for (const FactorManifestEntry& e : fingerprints()) {
+            if (is_stale(e)) {
+                out.push_back(e.yyyymmdd);
+            }
+        }
+        return out;
+    }
+
+    // fn(uint32_t worker, uint32_t yyyymmdd, const Segment&, std::vector<OutRow>& out) runs concurrently,
+    // rows must stay inside the input day. returns the number of days recomputed
+    template <class Fn>
+    size_t run(Fn&& fn) {
+        std::vector<FactorManifestEntry> stale;
+        for (const FactorManifestEntry& e : fingerprints()) {
+            if (is_stale(e)) {
+                stale.push_back(e);
+            }
+        }
+        if (stale.empty()) {
+            return 0;
+        }
+
+        ReaderOpt ro = input_opt();
+        for (const FactorManifestEntry& e : stale) {
+            ro.only_days.push_back(e.yyyymmdd);
+        }
+
+        ParallelReaderT<InSchema> pool(ro, opt_.threads);
+        auto writer = std::make_unique<WriterT<OutSchema>>(WriterOpt(opt_.base_dir, opt_.factor_product));
+        writer->start();
+
+        std::vector<uint64_t> out_rows(stale.size(), 0);
+        // only days the reduce received count as recomputed, a day that failed to stage (or is still empty) stays
+        // stale and is tried again on the next run
+        std::vector<uint8_t> done(stale.size(), 0);
+        pool.visit_days(
+            [&](uint32_t w, uint32_t d, const Segment& seg) {
+                std::vector<OutRow> rows;
+                fn(w, d, seg, rows);
+                return rows;
+            },
+            [&](uint32_t d, std::vector<OutRow>&& rows) {
+                for (const OutRow& r : rows) {
+                    while (!writer->enqueue(r)) {
+                        std::this_thread::yield();
+                    }
+                }
+                const size_t i = index_of(stale, d);
+                out_rows[i] = rows.size();
+                done[i] = 1;
+            });
+
+        writer->stop();
+        writer->join();
+        const uint64_t dropped = writer->dropped();
+        writer.reset();
+        if (dropped) {
+            throw std::runtime_error("[factorpipeline] writer dropped rows, manifest left untouched");
+        }
+
+        size_t recomputed = 0;
+        for (size_t i = 0; i < stale.size(); ++i) {
+            if (!done[i]) {
+                continue;
+            }
+            // the writer never opened a file for a day that now emits nothing, the old one would still be read
+            if (out_rows[i] == 0) {
+                std::error_code ec;
+                fs::remove(out_path(stale[i].yyyymmdd), ec);
+                if (ec) {
+                    throw std::runtime_error("[factorpipeline] could not remove the old output of an empty day");
+                }
+            }
+            stale[i].out_rows = out_rows[i];
+            upsert(stale[i]);
+            ++recomputed;
+        }
+        if (!write_manifest()) {
+            throw std::runtime_error("[factorpipeline] manifest write failed");
+        }
+        return recomputed;
+    }
+
+private:
+    ReaderOpt input_opt() const {
+        ReaderOpt ro;
+        ro.base_dir = opt_.base_dir;
+        ro.product = opt_.input_product;
+        ro.date_from = opt_.date_from;
+        ro.date_to = opt_.date_to;
+        ro.cols = opt_.input_cols;
+        return ro;
+    }
+
+    fs::path factor_dir() const { return fs::path(opt_.base_dir) / opt_.factor_product; }
+
+    fs::path out_path(uint32_t yyyymmdd) const {
+        char name[16];
+        std::snprintf(name, sizeof(name), "%08u.bin", yyyymmdd);
+        return factor_dir() / name;
+    }
+
+    static size_t index_of(const std::vector<FactorManifestEntry>& v, uint32_t d) {
+        return static_cast<size_t>(std::lower_bound(v.begin(), v.end(), d, [](const FactorManifestEntry& e, uint32_t x) {
+            return e.yyyymmdd < x;
+        }) - v.begin());
+    }
+
+    // current fingerprint of every input day in range, rows and crc from the input catalog, size and mtime from stat
+    std::vector<FactorManifestEntry> fingerprints() const {
+        const ReaderT<InSchema> plan(input_opt());
+        const DayCatalog cat(fs::path(opt_.base_dir) / opt_.input_product);
+
+        std::vector<FactorManifestEntry> out;
+        out.reserve(plan.days().size());
+        for (size_t k = 0; k < plan.days().size(); ++k) {
+            FactorManifestEntry e{};
+            e.yyyymmdd = plan.days()[k];
+            e.in_rows = plan.day_rows()[k];
+            e.param_hash = opt_.param_hash;
+            struct stat st{};
+            if (::stat(plan.paths()[k].c_str(), &st) == 0) {
+                e.in_bytes = static_cast<uint64_t>(st.st_size);
+                e.in_mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1'000'000'000ll + st.st_mtim.tv_nsec;
+            }
+            const auto it = std::lower_bound(cat.begin(), cat.end(), e.yyyymmdd,
+                                             [](const CatalogEntry& c, uint32_t d) { return c.yyyymmdd < d; });
+            if (it != cat.end() && it->yyyymmdd == e.yyyymmdd) {
+                e.in_crc = it->content_crc;
+            }
+            out.push_back(e);
+        }
+        return out;
+    }
+
+    bool is_stale(const FactorManifestEntry& now) const {
+        const size_t i = index_of(manifest_, now.yyyymmdd);
+        if (i == manifest_.size() || manifest_[i].yyyymmdd != now.yyyymmdd) {
+            return true;
+        }
+        const FactorManifestEntry& was = manifest_[i];
+        if (was.param_hash != now.param_hash || was.in_crc != now.in_crc || was.in_bytes != now.in_bytes ||
+            was.in_mtime_ns != now.in_mtime_ns || was.in_rows != now.in_rows) {
+            return true;
+        }
+        // output deleted behind our back
+        return was.out_rows != 0 && !fs::exists(out_path(now.yyyymmdd));
+    }
+
+    void upsert(const FactorManifestEntry& e) {
+        const size_t i = index_of(manifest_, e.yyyymmdd);
+        if (i < manifest_.size() && manifest_[i].yyyymmdd == e.yyyymmdd) {
+            manifest_[i] = e;
+        }
+        else {
+            manifest_.insert(manifest_.begin() + static_cast<std::ptrdiff_t>(i), e);
+        }
+    }
+
+    void load_manifest() {
+        manifest_.clear();
+        const fs::path p = factor_dir() / FILE_NAME;
+        const int fd = ::open(p.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        FactorManifestHeader hdr{};
+        bool ok = ::pread(fd, &hdr, sizeof(hdr), 0) == static_cast<ssize_t>(sizeof(hdr)) &&
+            std::memcmp(hdr.magic, MAGIC, sizeof(MAGIC)) == 0 && hdr.version == FACTOR_MANIFEST_VERSION;
+        if (ok) {
+            manifest_.resize(hdr.n_entries);
+            const size_t body = manifest_.size() * sizeof(FactorManifestEntry);
+            ok = body == 0 ||
+                ::pread(fd, manifest_.data(), body, sizeof(hdr)) == static_cast<ssize_t>(body);
+        }
+        ::close(fd);
+        if (!ok) {
+            manifest_.clear(); // unreadable manifest, everything is stale
+        }
+    }
+
+    bool write_manifest() const {
+        const fs::path dir = factor_dir();
+        std::error_code ec;
+        fs::create_directories(dir, ec);
+        const fs::path final_path = dir / FILE_NAME;
+        const fs::path tmp_path = dir / (std::string(FILE_NAME) + ".tmp");
+
+        FactorManifestHeader hdr{};
+        std::memcpy(hdr.magic, MAGIC, sizeof(MAGIC));
+        hdr.version = FACTOR_MANIFEST_VERSION;
+        hdr.n_entries = static_cast<uint32_t>(manifest_.size());
+
+        const int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        const size_t body = manifest_.size() * sizeof(FactorManifestEntry);
+        bool ok = ::write(fd, &hdr, sizeof(hdr)) == static_cast<ssize_t>(sizeof(hdr));
+        ok = ok && (body == 0 || ::write(fd, manifest_.data(), body) == static_cast<ssize_t>(body));
+        ok = ok && ::fdatasync(fd) == 0;
+        ::close(fd);
+        if (!ok || ::rename(tmp_path.c_str(), final_path.c_str()) != 0) {
+            ::unlink(tmp_path.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    FactorPipelineOpt opt_;
+    std::vector<FactorManifestEntry> manifest_; // sorted by day
+};
+
+using L2ImbalancePipeline = FactorPipelineT<L2Schema, ImbalanceSchema>;
+using L2VwapPipeline = FactorPipelineT<L2Schema, VwapSchema>;
@@ -0,0 +1,368 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#include "reader.h"
+
+// reusable buffers for the windowed kernels, keep one per thread and the kernels never allocate after warm up
+struct FactorScratch {
+    std::vector<double> a;
+    std::vector<double> b;
+};
+
+// columnar factor kernels over staged segments, results go straight into factor column buffers
+// (ImbalanceSchema::COL_IMB, VwapSchema::COL_VWAP, VoiSchema::COL_MID, ...)
+//
+// windowed kernels are built on inclusive prefix sums in double, so a tick window is one subtraction per row
+// and a time window is a two pointer walk, no running sum drift. windows start fresh on every segment (day).
+// side: 1 = bid, 0 = ask. avx2 when built with it, scalar otherwise
+struct Factors {
+    // p[0] = 0, p[i + 1] = x[0] + ... + x[i]
+    static void prefix_sum(const float* x, size_t n, double* p) {
+        p[0] = 0.0;
+        size_t i = 0;
+#if defined(__AVX2__)
+        __m256d carry = _mm256_setzero_pd();
+        for (; i + 4 <= n; i += 4) {
+            const __m256d v = _mm256_cvtps_pd(_mm_loadu_ps(x + i));
+            carry = scan_store(v, carry, p + i + 1);
+        }
+#endif
+        for (; i < n; ++i) {
+            p[i + 1] = p[i] + static_cast<double>(x[i]);
+        }
+    }
+
+    // prefix of px * qty, the vwap numerator
+    static void prefix_sum_notional(const uint32_t* px, const float* qty, size_t n, double* p) {
+        p[0] = 0.0;
+        size_t i = 0;
+#if defined(__AVX2__)
+        __m256d carry = _mm256_setzero_pd();
+        for (; i + 4 <= n; i += 4) {
+            const __m256d v = _mm256_mul_pd(u32_to_pd(px + i), _mm256_cvtps_pd(_mm_loadu_ps(qty + i)));
+            carry = scan_store(v, carry, p + i + 1);
+        }
+#endif
+        for (; i < n; ++i) {
+            p[i + 1] = p[i] + static_cast<double>(px[i]) * static_cast<double>(qty[i]);
+        }
+    }
+
+    // +qty on bids, -qty on asks
+    static void signed_qty(const uint8_t* side, const float* qty, size_t n, float* out) {
+        size_t i = 0;
+#if defined(__AVX2__)
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i sign = _mm256_set1_epi32(static_cast<int>(0x80000000u));
+        for (; i + 8 <= n; i += 8) {
+            const __m256i s = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(side + i)));
+            const __m256i ask = _mm256_and_si256(_mm256_cmpeq_epi32(s, zero), sign);
+            const __m256 q = _mm256_loadu_ps(qty + i);
+            _mm256_storeu_ps(out + i, _mm256_xor_ps(q, _mm256_castsi256_ps(ask)));
+        }
+#endif
+        for (; i < n; ++i) {
+            out[i] = side[i] ? qty[i] : -qty[i];
+        }
+    }
+
+    // sum of the last w values (fewer at the start of the segment)
+    static void rolling_sum(const float* x, size_t n, size_t w, float* out, FactorScratch& s) {
+        if (n == 0 || w == 0) {
+            return;
+        }
+        s.a.resize(n + 1);
+        prefix_sum(x, n, s.a.data());
+        window_diff(s.a.data(), n, w, out);
+    }
+
+    // sum over (ts[i] - window_ns, ts[i]], ts must be non decreasing
+    static void rolling_sum_time(const uint64_t* ts, const float* x, size_t n, uint64_t window_ns, float* out,
+                                 FactorScratch& s) {
+        if (n == 0) {
+            return;
+        }
+        s.a.resize(n + 1);
+        prefix_sum(x, n, s.a.data());
+        const double* p = s.a.data();
+        size_t j = 0;
+        for (size_t i = 0; i < n; ++i) {
+            while (j <= i && ts[j] + window_ns <= ts[i]) {
+                ++j;
+            }
+            out[i] = static_cast<float>(p[i + 1] - p[j]);
+        }
+    }
+
+    // sum(signed qty) / sum(qty) over the last w events, in [-1, 1], 0 when the window has no size
+    static void flow_imbalance(const uint8_t* side, const float* qty, size_t n, size_t w, float* out,
+                               FactorScratch& s) {
+        if (n == 0 || w == 0) {
+            return;
+        }
+        s.a.resize(n + 1);
+        s.b.resize(n + 1);
+        signed_qty(side, qty, n, out); // out doubles as the signed flow buffer
+        prefix_sum(out, n, s.a.data());
+        prefix_sum(qty, n, s.b.data());
+        window_ratio(s.a.data(), s.b.data(), n, w, out);
+    }
+
+    static void flow_imbalance_time(const uint64_t* ts, const uint8_t* side, const float* qty, size_t n,
+                                    uint64_t window_ns, float* out, FactorScratch& s) {
+        if (n == 0) {
+            return;
+        }
+        s.a.resize(n + 1);
+        s.b.resize(n + 1);
+        signed_qty(side, qty, n, out);
+        prefix_sum(out, n, s.a.data());
+        prefix_sum(qty, n, s.b.data());
+        time_ratio(ts, s.a.data(), s.b.data(), n, window_ns, out);
+    }
+
+    // sum(px * qty) / sum(qty) over the last w events, in price ticks, 0 when the window has no size
+    static void vwap(const uint32_t* px, const float* qty, size_t n, size_t w, float* out, FactorScratch& s) {
+        if (n == 0 || w == 0) {
+            return;
+        }
+        s.a.resize(n + 1);
+        s.b.resize(n + 1);
+        prefix_sum_notional(px, qty, n, s.a.data());
+        prefix_sum(qty, n, s.b.data());
+        window_ratio(s.a.data(), s.b.data(), n, w, out);
+    }
+
+    static void vwap_time(const uint64_t* ts, const uint32_t* px, const float* qty, size_t n, uint64_t window_ns,
+                          float* out, FactorScratch& s) {
+        if (n == 0) {
+            return;
+        }
+        s.a.resize(n + 1);
+        s.b.resize(n + 1);
+        prefix_sum_notional(px, qty, n, s.a.data());
+        prefix_sum(qty, n, s.b.data());
+        time_ratio(ts, s.a.data(), s.b.data(), n, window_ns, out);
+    }
+
+    // y[i] = alpha * x[i] + (1 - alpha) * y[i - 1], state carries y across segments (seed it with the first value)
+    static void ema(const float* x, size_t n, double alpha, float* out, double& state) {
+        const double b = 1.0 - alpha;
+        double y = state;
+        size_t i = 0;
+#if defined(__AVX2__)
+        // 4 wide scan: z = alpha * x, z += b * z[-1], z += b^2 * z[-2], y = z + b^(k + 1) * y_prev
+        const __m256d va = _mm256_set1_pd(alpha);
+        const __m256d b1 = _mm256_set1_pd(b);
+        const __m256d b2 = _mm256_set1_pd(b * b);
+        const __m256d bk = _mm256_setr_pd(b, b * b, b * b * b, b * b * b * b);
+        const __m256d zero = _mm256_setzero_pd();
+        __m256d prev = _mm256_set1_pd(y);
+        for (; i + 4 <= n; i += 4) {
+            __m256d z = _mm256_mul_pd(va, _mm256_cvtps_pd(_mm_loadu_ps(x + i)));
+            __m256d sh = _mm256_blend_pd(_mm256_permute4x64_pd(z, _MM_SHUFFLE(2, 1, 0, 0)), zero, 0x1);
+            z = _mm256_add_pd(z, _mm256_mul_pd(b1, sh));
+            sh = _mm256_blend_pd(_mm256_permute4x64_pd(z, _MM_SHUFFLE(1, 0, 0, 0)), zero, 0x3);
+            z = _mm256_add_pd(z, _mm256_mul_pd(b2, sh));
+            z = _mm256_add_pd(z, _mm256_mul_pd(bk, prev));
+            _mm_storeu_ps(out + i, _mm256_cvtpd_ps(z));
+            prev = _mm256_permute4x64_pd(z, _MM_SHUFFLE(3, 3, 3, 3));
+        }
+        y = _mm256_cvtsd_f64(prev);
+#endif
+        for (; i < n; ++i) {
+            y = alpha * static_cast<double>(x[i]) + b * y;
+            out[i] = static_cast<float>(y);
+        }
+        state = y;
+    }
+
+    // irregularly spaced ema, decay exp(-dt / tau), last_ts = 0 means no history.
+    // the decay differs per row so the recurrence stays scalar
+    static void ema_time(const uint64_t* ts, const float* x, size_t n, uint64_t tau_ns, float* out, double& state,
+                         uint64_t& last_ts) {
+        const double inv_tau = 1.0 / static_cast<double>(tau_ns);
+        double y = state;
+        uint64_t prev = last_ts;
+        for (size_t i = 0; i < n; ++i) {
+            if (prev == 0) {
+                y = x[i];
+            }
+            else {
+                const double d = std::exp(-static_cast<double>(ts[i] - prev) * inv_tau);
+                y = d * y + (1.0 - d) * static_cast<double>(x[i]);
+            }
+            prev = ts[i];
+            out[i] = static_cast<float>(y);
+        }
+        state = y;
+        last_ts = prev;
+    }
+
+    // volume order imbalance over top of book columns, out[0] = 0.
+    // bid leg: bid_sz if the bid moved up, bid_sz - prev if it stayed, 0 if it moved down, ask leg mirrored
+    static void voi(const uint32_t* bid_px, const float* bid_sz, const uint32_t* ask_px, const float* ask_sz,
+                    size_t n, float* out) {
+        if (n == 0) {
+            return;
+        }
+        out[0] = 0.0f;
+        size_t i = 1;
+#if defined(__AVX2__)
+        const __m256i flip = _mm256_set1_epi32(static_cast<int>(0x80000000u));
+        const __m256 zero = _mm256_setzero_ps();
+        for (; i + 8 <= n; i += 8) {
+            const __m256i bp = _mm256_xor_si256(load_u32(bid_px + i), flip);
+            const __m256i bp0 = _mm256_xor_si256(load_u32(bid_px + i - 1), flip);
+            const __m256i ap = _mm256_xor_si256(load_u32(ask_px + i), flip);
+            const __m256i ap0 = _mm256_xor_si256(load_u32(ask_px + i - 1), flip);
+            const __m256 bs = _mm256_loadu_ps(bid_sz + i);
+            const __m256 bs0 = _mm256_loadu_ps(bid_sz + i - 1);
+            const __m256 as = _mm256_loadu_ps(ask_sz + i);
+            const __m256 as0 = _mm256_loadu_ps(ask_sz + i - 1);
+
+            const __m256 b_up = _mm256_castsi256_ps(_mm256_cmpgt_epi32(bp, bp0));
+            const __m256 b_eq = _mm256_castsi256_ps(_mm256_cmpeq_epi32(bp, bp0));
+            const __m256 a_dn = _mm256_castsi256_ps(_mm256_cmpgt_epi32(ap0, ap));
+            const __m256 a_eq = _mm256_castsi256_ps(_mm256_cmpeq_epi32(ap, ap0));
+
+            __m256 dvb = _mm256_blendv_ps(zero, bs, b_up);
+            dvb = _mm256_blendv_ps(dvb, _mm256_sub_ps(bs, bs0), b_eq);
+            __m256 dva = _mm256_blendv_ps(zero, as, a_dn);
+            dva = _mm256_blendv_ps(dva, _mm256_sub_ps(as, as0), a_eq);
+            _mm256_storeu_ps(out + i, _mm256_sub_ps(dvb, dva));
+        }
+#endif
+        for (; i < n; ++i) {
+            const float dvb = bid_px[i] > bid_px[i - 1] ? bid_sz[i]
+                            : bid_px[i] == bid_px[i - 1] ? bid_sz[i] - bid_sz[i - 1] : 0.0f;
+            const float dva = ask_px[i] < ask_px[i - 1] ? ask_sz[i]
+                            : ask_px[i] == ask_px[i - 1] ? ask_sz[i] - ask_sz[i - 1] : 0.0f;
+            out[i] = dvb - dva;
+        }
+    }
+
+    // floor((bid + ask) / 2) without overflow
+    static void mid(const uint32_t* bid_px, const uint32_t* ask_px, size_t n, uint32_t* out) {
+        size_t i = 0;
+#if defined(__AVX2__)
+        const __m256i one = _mm256_set1_epi32(1);
+        for (; i + 8 <= n; i += 8) {
+            const __m256i b = load_u32(bid_px + i);
+            const __m256i a = load_u32(ask_px + i);
+            const __m256i half = _mm256_add_epi32(_mm256_srli_epi32(b, 1), _mm256_srli_epi32(a, 1));
+            const __m256i odd = _mm256_and_si256(_mm256_and_si256(a, b), one);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_add_epi32(half, odd));
+        }
+#endif
+        for (; i < n; ++i) {
+            out[i] = (bid_px[i] >> 1) + (ask_px[i] >> 1) + (bid_px[i] & ask_px[i] & 1u);
+        }
+    }
+
+    // l2 segment shorthands
+    using L2Segment = ReaderT<L2Schema>::Segment;
+
+    static void vwap(const L2Segment& seg, size_t w, float* out, FactorScratch& s) {
+        vwap(seg.col<uint32_t>(L2Schema::COL_PX), seg.col<float>(L2Schema::COL_QTY), seg.rows, w, out, s);
+    }
+
+    static void vwap_time(const L2Segment& seg, uint64_t window_ns, float* out, FactorScratch& s) {
+        vwap_time(seg.col<uint64_t>(L2Schema::COL_TS), seg.col<uint32_t>(L2Schema::COL_PX),
+                  seg.col<float>(L2Schema::COL_QTY), seg.rows, window_ns, out, s);
+    }
+
+    static void flow_imbalance(const L2Segment& seg, size_t w, float* out, FactorScratch& s) {
+        flow_imbalance(seg.col<uint8_t>(L2Schema::COL_SIDE), seg.col<float>(L2Schema::COL_QTY), seg.rows, w, out, s);
+    }
+
+    static void flow_imbalance_time(const L2Segment& seg, uint64_t window_ns, float* out, FactorScratch& s) {
+        flow_imbalance_time(seg.col<uint64_t>(L2Schema::COL_TS), seg.col<uint8_t>(L2Schema::COL_SIDE),
+                            seg.col<float>(L2Schema::COL_QTY), seg.rows, window_ns, out, s);
+    }
+
+private:
+    // out[i] = p[i + 1] - p[max(0, i + 1 - w)]
+    static void window_diff(const double* p, size_t n, size_t w, float* out) {
+        const size_t head = std::min(n, w);
+        for (size_t i = 0; i < head; ++i) {
+            out[i] = static_cast<float>(p[i + 1]);
+        }
+        size_t i = head;
+#if defined(__AVX2__)
+        for (; i + 4 <= n; i += 4) {
+            const __m256d d = _mm256_sub_pd(_mm256_loadu_pd(p + i + 1), _mm256_loadu_pd(p + i + 1 - w));
+            _mm_storeu_ps(out + i, _mm256_cvtpd_ps(d));
+        }
+#endif
+        for (; i < n; ++i) {
+            out[i] = static_cast<float>(p[i + 1] - p[i + 1 - w]);
+        }
+    }
+
+    static inline float safe_div(double num, double den) {
+        return den != 0.0 ? static_cast<float>(num / den) : 0.0f;
+    }
+
+    // out[i] = window(num) / window(den), 0 where the denominator window is 0
+    static void window_ratio(const double* pn, const double* pd, size_t n, size_t w, float* out) {
+        const size_t head = std::min(n, w);
+        for (size_t i = 0; i < head; ++i) {
+            out[i] = safe_div(pn[i + 1], pd[i + 1]);
+        }
+        size_t i = head;
+#if defined(__AVX2__)
+        const __m256d zero = _mm256_setzero_pd();
+        for (; i + 4 <= n; i += 4) {
+            const __m256d num = _mm256_sub_pd(_mm256_loadu_pd(pn + i + 1), _mm256_loadu_pd(pn + i + 1 - w));
+            const __m256d den = _mm256_sub_pd(_mm256_loadu_pd(pd + i + 1), _mm256_loadu_pd(pd + i + 1 - w));
+            const __m256d nz = _mm256_cmp_pd(den, zero, _CMP_NEQ_OQ);
+            const __m256d q = _mm256_and_pd(_mm256_div_pd(num, den), nz);
+            _mm_storeu_ps(out + i, _mm256_cvtpd_ps(q));
+        }
+#endif
+        for (; i < n; ++i) {
+            out[i] = safe_div(pn[i + 1] - pn[i + 1 - w], pd[i + 1] - pd[i + 1 - w]);
+        }
+    }
+
+    static void time_ratio(const uint64_t* ts, const double* pn, const double* pd, size_t n, uint64_t window_ns,
+                           float* out) {
+        size_t j = 0;
+        for (size_t i = 0; i < n; ++i) {
+            while (j <= i && ts[j] + window_ns <= ts[i]) {
+                ++j;
+            }
+            out[i] = safe_div(pn[i + 1] - pn[j], pd[i + 1] - pd[j]);
+        }
+    }
+
+#if defined(__AVX2__)
+    static inline __m256i load_u32(const uint32_t* p) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    }
+
+    // exact for any u32, cvtepi32 alone would treat the top bit as sign
+    static inline __m256d u32_to_pd(const uint32_t* p) {
+        const __m256i v = _mm256_cvtepu32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+        const __m256i magic = _mm256_castpd_si256(_mm256_set1_pd(4503599627370496.0)); // 2^52
+        return _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(v, magic)), _mm256_set1_pd(4503599627370496.0));
+    }
+
+    // inclusive scan of 4 doubles plus carry, stores it and returns the new carry (last lane broadcast)
+    static inline __m256d scan_store(__m256d v, __m256d carry, double* dst) {
+        v = _mm256_add_pd(v, _mm256_castsi256_pd(_mm256_slli_si256(_mm256_castpd_si256(v), 8)));
+        const __m256d lo = _mm256_permute4x64_pd(v, _MM_SHUFFLE(1, 1, 0, 0));
+        v = _mm256_add_pd(v, _mm256_blend_pd(_mm256_setzero_pd(), lo, 0xC));
+        v = _mm256_add_pd(v, carry);
+        _mm256_storeu_pd(dst, v);
+        return _mm256_permute4x64_pd(v, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+#endif
+};
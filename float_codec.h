@@ -0,0 +1,391 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+#include <numeric>
+#include <vector>
+#include <stdexcept>
+#include "bitpack.h"
+#include "col_codec.h"
+
+// per block encodings for float columns (qty/size)
+enum class FloatEnc : uint8_t {
+    RAW = 0,
+    GORILLA = 1, // xor with previous value, facebook gorilla style control bits
+    SHUFFLE = 2, // byte planes, each plane frame of reference + bitpacked
+    DECIMAL = 3, // value * 10^decimals is an exact multiple of a lot size, stored as bitpacked lots
+    BITS_DELTA = 4, // ieee bit patterns as u32 through ColCodec, smooth same sign series have small deltas
+};
+
+struct FloatCodec : BitPack {
+    static constexpr uint32_t MAX_DECIMALS = 9;
+
+#pragma pack(push, 1)
+    struct DecimalHeader {
+        uint8_t decimals;
+        uint8_t bw;
+        uint16_t reserved0;
+        uint32_t reserved1;
+        uint64_t lot;
+        int64_t base;
+    };
+
+    struct PlaneHeader {
+        uint8_t min;
+        uint8_t bw;
+    };
+#pragma pack(pop)
+
+    // lsb first bit stream, same bit order as bitpack_u32
+    struct BitWriter {
+        std::vector<uint8_t>& out;
+        uint64_t acc{0};
+        uint32_t bits{0};
+
+        explicit BitWriter(std::vector<uint8_t>& o) : out(o) {
+        }
+
+        inline void put(uint64_t v, uint32_t bw) {
+            acc |= (v & ((1ull << bw) - 1ull)) << bits;
+            bits += bw;
+            while (bits >= 8) {
+                out.push_back(static_cast<uint8_t>(acc & 0xffu));
+                acc >>= 8;
+                bits -= 8;
+            }
+        }
+
+        inline void flush() {
+            if (bits > 0) {
+                out.push_back(static_cast<uint8_t>(acc & 0xffu));
+                acc = 0;
+                bits = 0;
+            }
+        }
+    };
+
+    struct BitReader {
+        const uint8_t* src;
+        const uint8_t* end;
+        uint64_t acc{0};
+        uint32_t bits{0};
+
+        BitReader(const uint8_t* s, size_t len) : src(s), end(s + len) {
+        }
+
+        inline uint32_t get(uint32_t bw) {
+            while (bits < bw) {
+                if (src == end) {
+                    throw std::runtime_error("[floatcodec] bit stream truncated");
+                }
+                acc |= static_cast<uint64_t>(*src++) << bits;
+                bits += 8;
+            }
+            const uint32_t v = static_cast<uint32_t>(acc & ((1ull << bw) - 1ull));
+            acc >>= bw;
+            bits -= bw;
+            return v;
+        }
+    };
+
+    static inline uint32_t f2u(float f) {
+        uint32_t u;
+        std::memcpy(&u, &f, sizeof(u));
+        return u;
+    }
+
+    static inline float u2f(uint32_t u) {
+        float f;
+        std::memcpy(&f, &u, sizeof(f));
+        return f;
+    }
+
+    static inline double pow10(uint32_t e) {
+        static constexpr double p[MAX_DECIMALS + 1] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9
+        };
+        return p[e];
+    }
+
+    // decoder side conversion, the encoder checks every value against this exact expression
+    static inline float from_decimal(int64_t q, uint32_t decimals) {
+        return static_cast<float>(static_cast<double>(q) / pow10(decimals));
+    }
+
+    static inline bool to_decimal(float v, uint32_t decimals, int64_t& q) {
+        if (!std::isfinite(v)) {
+            return false;
+        }
+        const double d = static_cast<double>(v) * pow10(decimals);
+        if (std::fabs(d) >= 9007199254740992.0) {
+            return false;
+        }
+        q = std::llround(d);
+        return f2u(from_decimal(q, decimals)) == f2u(v);
+    }
+
+    static void encode_raw(const float* vals, size_t n, std::vector<uint8_t>& out) {
+        const size_t before = out.size();
+        out.resize(before + n * sizeof(float));
+        std::memcpy(out.data() + before, vals, n * sizeof(float));
+    }
+
+    static void encode_gorilla(const float* vals, size_t n, std::vector<uint8_t>& out) {
+        BitWriter w(out);
+        uint32_t prev = f2u(vals[0]);
+        w.put(prev, 32);
+
+        uint32_t prev_lead = 32;
+        uint32_t prev_trail = 0;
+        for (size_t i = 1; i < n; ++i) {
+            const uint32_t cur = f2u(vals[i]);
+            const uint32_t x = cur ^ prev;
+            prev = cur;
+            if (x == 0) {
+                w.put(0, 1);
+                continue;
+            }
+            w.put(1, 1);
+
+            const uint32_t lead = static_cast<uint32_t>(__builtin_clz(x));
+            const uint32_t trail = static_cast<uint32_t>(__builtin_ctz(x));
+            if (prev_lead != 32 && lead >= prev_lead && trail >= prev_trail) {
+                // meaningful bits fit inside the previous window
+                w.put(0, 1);
+                w.put(x >> prev_trail, 32 - prev_lead - prev_trail);
+                continue;
+            }
+
+            const uint32_t sig = 32 - lead - trail;
+            w.put(1, 1);
+            w.put(lead, 5);
+            w.put(sig - 1, 5);
+            w.put(x >> trail, sig);
+            prev_lead = lead;
+            prev_trail = trail;
+        }
+        w.flush();
+    }
+
+    static void encode_shuffle(const float* vals, size_t n, std::vector<uint8_t>& out) {
+        std::vector<uint32_t> plane(n);
+        for (uint32_t b = 0; b < sizeof(float); ++b) {
+            const uint32_t shift = b * 8;
+            uint32_t lo = 0xff;
+            uint32_t hi = 0;
+            for (size_t i = 0; i < n; ++i) {
+                const uint32_t v = (f2u(vals[i]) >> shift) & 0xffu;
+                plane[i] = v;
+                lo = v < lo ? v : lo;
+                hi = v > hi ? v : hi;
+            }
+
+            PlaneHeader ph{};
+            ph.min = static_cast<uint8_t>(lo);
+            ph.bw = hi == lo ? 0 : static_cast<uint8_t>(ceil_log2_u64(hi - lo + 1));
+            const size_t before = out.size();
+            out.resize(before + sizeof(PlaneHeader));
+            std::memcpy(out.data() + before, &ph, sizeof(PlaneHeader));
+
+            for (size_t i = 0; i < n; ++i) {
+                plane[i] -= lo;
+            }
+            bitpack_u32(plane.data(), n, ph.bw, out);
+        }
+    }
+
+    static bool encode_decimal(const float* vals, size_t n, std::vector<uint8_t>& out) {
+        uint32_t decimals = 0;
+        for (size_t i = 0; i < n; ++i) {
+            int64_t q;
+            while (!to_decimal(vals[i], decimals, q)) {
+                if (++decimals > MAX_DECIMALS) {
+                    return false;
+                }
+            }
+        }
+
+        // a coarser scale that worked for one value is not guaranteed to survive the final scale
+        std::vector<int64_t> q(n);
+        uint64_t lot = 0;
+        for (size_t i = 0; i < n; ++i) {
+            if (!to_decimal(vals[i], decimals, q[i])) {
+                return false;
+            }
+            lot = std::gcd(lot, static_cast<uint64_t>(q[i] < 0 ? -q[i] : q[i]));
+        }
+        if (lot == 0) {
+            lot = 1;
+        }
+
+        int64_t base = q[0] / static_cast<int64_t>(lot);
+        for (size_t i = 0; i < n; ++i) {
+            q[i] /= static_cast<int64_t>(lot);
+            base = q[i] < base ? q[i] : base;
+        }
+
+        std::vector<uint64_t> units(n);
+        uint64_t max_u = 0;
+        for (size_t i = 0; i < n; ++i) {
+            units[i] = static_cast<uint64_t>(q[i] - base);
+            max_u = units[i] > max_u ? units[i] : max_u;
+        }
+
+        DecimalHeader dh{};
+        dh.decimals = static_cast<uint8_t>(decimals);
+        dh.bw = static_cast<uint8_t>(ColCodec::bw_of(max_u));
+        dh.lot = lot;
+        dh.base = base;
+        if (dh.bw > 56) {
+            return false;
+        }
+
+        const size_t before = out.size();
+        out.resize(before + sizeof(DecimalHeader));
+        std::memcpy(out.data() + before, &dh, sizeof(DecimalHeader));
+        bitpack_u64(units.data(), n, dh.bw, out);
+        return true;
+    }
+
+    static void encode_bits_delta(const float* vals, size_t n, std::vector<uint8_t>& out) {
+        std::vector<uint64_t> bits(n);
+        for (size_t i = 0; i < n; ++i) {
+            bits[i] = f2u(vals[i]);
+        }
+        const size_t tag = out.size();
+        out.push_back(0);
+        out[tag] = static_cast<uint8_t>(ColCodec::encode(bits.data(), n, sizeof(uint32_t), out));
+    }
+
+    // tries every encoding, appends the smallest to out
+    static FloatEnc encode(const float* vals, size_t n, std::vector<uint8_t>& out) {
+        if (n == 0) {
+            return FloatEnc::RAW;
+        }
+
+        FloatEnc best = FloatEnc::RAW;
+        size_t best_len = n * sizeof(float);
+        std::vector<uint8_t> cand[4];
+
+        encode_gorilla(vals, n, cand[0]);
+        encode_shuffle(vals, n, cand[1]);
+        const bool decimal_ok = encode_decimal(vals, n, cand[2]);
+        encode_bits_delta(vals, n, cand[3]);
+
+        const FloatEnc encs[4] = {FloatEnc::GORILLA, FloatEnc::SHUFFLE, FloatEnc::DECIMAL, FloatEnc::BITS_DELTA};
+        int best_idx = -1;
+        for (int i = 0; i < 4; ++i) {
+            if (encs[i] == FloatEnc::DECIMAL && !decimal_ok) {
+                continue;
+            }
+            if (cand[i].size() < best_len) {
+                best_len = cand[i].size();
+                best = encs[i];
+                best_idx = i;
+            }
+        }
+
+        if (best_idx < 0) {
+            encode_raw(vals, n, out);
+        }
+        else {
+            out.insert(out.end(), cand[best_idx].begin(), cand[best_idx].end());
+        }
+        return best;
+    }
+
+    static void decode(FloatEnc enc, const uint8_t* src, size_t len, size_t n, float* out) {
+        if (n == 0) {
+            return;
+        }
+
+        switch (enc) {
+        case FloatEnc::RAW: {
+            if (len < n * sizeof(float)) {
+                throw std::runtime_error("[floatcodec] raw column truncated");
+            }
+            std::memcpy(out, src, n * sizeof(float));
+            return;
+        }
+        case FloatEnc::GORILLA: {
+            BitReader r(src, len);
+            uint32_t prev = r.get(32);
+            out[0] = u2f(prev);
+            uint32_t lead = 0;
+            uint32_t trail = 0;
+            for (size_t i = 1; i < n; ++i) {
+                if (r.get(1) == 0) {
+                    out[i] = u2f(prev);
+                    continue;
+                }
+                if (r.get(1) == 1) {
+                    lead = r.get(5);
+                    const uint32_t sig = r.get(5) + 1;
+                    trail = 32 - lead - sig;
+                }
+                const uint32_t x = r.get(32 - lead - trail) << trail;
+                prev ^= x;
+                out[i] = u2f(prev);
+            }
+            return;
+        }
+        case FloatEnc::SHUFFLE: {
+            std::vector<uint32_t> plane(n);
+            std::memset(out, 0, n * sizeof(float));
+            size_t off = 0;
+            for (uint32_t b = 0; b < sizeof(float); ++b) {
+                if (off + sizeof(PlaneHeader) > len) {
+                    throw std::runtime_error("[floatcodec] shuffle column truncated");
+                }
+                PlaneHeader ph{};
+                std::memcpy(&ph, src + off, sizeof(PlaneHeader));
+                off += sizeof(PlaneHeader);
+
+                const size_t packed = (n * ph.bw + 7) / 8;
+                if (off + packed > len) {
+                    throw std::runtime_error("[floatcodec] shuffle column truncated");
+                }
+                bitunpack_u32(src + off, n, ph.bw, plane.data());
+                off += packed;
+
+                const uint32_t shift = b * 8;
+                for (size_t i = 0; i < n; ++i) {
+                    const uint32_t u = f2u(out[i]) | ((plane[i] + ph.min) & 0xffu) << shift;
+                    out[i] = u2f(u);
+                }
+            }
+            return;
+        }
+        case FloatEnc::DECIMAL: {
+            if (len < sizeof(DecimalHeader)) {
+                throw std::runtime_error("[floatcodec] decimal column truncated");
+            }
+            DecimalHeader dh{};
+            std::memcpy(&dh, src, sizeof(DecimalHeader));
+            if (dh.decimals > MAX_DECIMALS || (len - sizeof(DecimalHeader)) < (n * dh.bw + 7) / 8) {
+                throw std::runtime_error("[floatcodec] decimal header corrupt");
+            }
+
+            std::vector<uint64_t> units(n);
+            bitunpack_u64(src + sizeof(DecimalHeader), n, dh.bw, units.data());
+            const int64_t lot = static_cast<int64_t>(dh.lot);
+            for (size_t i = 0; i < n; ++i) {
+                const int64_t q = (dh.base + static_cast<int64_t>(units[i])) * lot;
+                out[i] = from_decimal(q, dh.decimals);
+            }
+            return;
+        }
+        case FloatEnc::BITS_DELTA: {
+            if (len < 1) {
+                throw std::runtime_error("[floatcodec] bits delta column truncated");
+            }
+            std::vector<uint32_t> bits(n);
+            ColCodec::decode_u32(static_cast<ColEnc>(src[0]), src + 1, len - 1, n, bits.data());
+            std::memcpy(out, bits.data(), n * sizeof(float));
+            return;
+        }
+        }
+        throw std::runtime_error("[floatcodec] unknown float encoding");
+    }
+};
@@ -0,0 +1,324 @@
+#pragma once
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/statfs.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "schemas.h"
+#include "huge_buff.h"
+
+#ifndef HUGETLBFS_MAGIC
+#define HUGETLBFS_MAGIC 0x958458f6
+#endif
+
+#ifndef TMPFS_MAGIC
+#define TMPFS_MAGIC 0x01021994
+#endif
+
+#ifndef RAMFS_MAGIC
+#define RAMFS_MAGIC 0x858458f6
+#endif
+
+namespace fs = std::filesystem;
+
+// copies of recently used day files on a hugetlbfs (or tmpfs with huge=advise) mount, <dir>/<product>/<day>.bin.
+// the copy is the source trimmed to its rows with every column on a 2 MB boundary, so a reader maps it straight
+// out of memory with 2 MB pages and hands out pointers into it instead of staging.
+// a day is promoted on its after_uses-th use (counted across processes by <day>.uses), the oldest copies by last use
+// (atime, set on every hit) are evicted to keep the whole dir under budget_bytes. a copy is current while its mtime
+// equals the source's, a rewritten source makes it stale and it is dropped on the next lookup.
+// readers in other processes share the tier, copies are written under a temporary name and renamed into place
+template <class Schema>
+class HotDayCacheT {
+public:
+    using Header = ColFileHeaderT<Schema>;
+
+    HotDayCacheT(const std::string& dir, const std::string& product, uint64_t budget_bytes, uint32_t after_uses)
+        : root_(dir), dir_(fs::path(dir) / product), budget_(budget_bytes), after_uses_(std::max(1u, after_uses)) {
+        std::error_code ec;
+        fs::create_directories(dir_, ec);
+        struct statfs sf{};
+        if (ec || ::statfs(dir_.c_str(), &sf) != 0) {
+            warn_once("cannot create or stat the cache dir, cache off");
+            return;
+        }
+        const auto type = static_cast<unsigned long>(sf.f_type);
+        hugetlbfs_ = type == HUGETLBFS_MAGIC;
+        if (!hugetlbfs_ && type != TMPFS_MAGIC && type != RAMFS_MAGIC) {
+            warn_once("cache dir is not on hugetlbfs or tmpfs, cache off");
+            return;
+        }
+        ok_ = true;
+    }
+
+    HotDayCacheT(const HotDayCacheT&) = delete;
+    HotDayCacheT& operator=(const HotDayCacheT&) = delete;
+
+    bool ok() const noexcept { return ok_; }
+    bool hugetlbfs() const noexcept { return hugetlbfs_; }
+    uint64_t hits() const noexcept { return hits_; }
+    uint64_t misses() const noexcept { return misses_; }
+    uint64_t promoted() const noexcept { return promoted_; }
+    uint64_t evicted() const noexcept { return evicted_; }
+
+    // the cached copy of src when it is current, empty otherwise. a hit counts as a use for the lru
+    fs::path find(const fs::path& src) {
+        if (!ok_) {
+            return {};
+        }
+        const fs::path hot = dir_ / src.filename();
+        struct stat hs{};
+        if (::stat(hot.c_str(), &hs) != 0) {
+            ++misses_;
+            return {};
+        }
+        struct stat ss{};
+        if (::stat(src.c_str(), &ss) != 0 || !same_time(hs.st_mtim, ss.st_mtim)) {
+            ::unlink(hot.c_str());
+            ++misses_;
+            return {};
+        }
+        const timespec t[2] = {{0, UTIME_NOW}, {0, UTIME_OMIT}};
+        ::utimensat(AT_FDCWD, hot.c_str(), t, 0);
+        ++hits_;
+        return hot;
+    }
+
+    // one use of src (not served from the cache), copies it in once it reached after_uses. cols[c] is column c of
+    // src with hdr.rows rows, nullptr for columns the caller does not have, those are read from src itself.
+    // false when nothing was promoted
+    bool note_use(const fs::path& src, const Header& hdr, const void* const* cols) {
+        if (!ok_ || hdr.rows == 0) {
+            return false;
+        }
+        struct stat ss{};
+        if (::stat(src.c_str(), &ss) != 0) {
+            return false;
+        }
+        // a day the writer is still appending to changes under us, leave it alone until it settles
+        if (std::time(nullptr) - ss.st_mtim.tv_sec < SETTLE_S) {
+            return false;
+        }
+        const fs::path uses = dir_ / (src.stem().string() + ".uses");
+        if (count_use(uses) < after_uses_) {
+            return false;
+        }
+
+        Header out = hdr;
+        const uint64_t bytes = lay_out(out);
+        if (bytes > budget_) {
+            return false;
+        }
+        make_room(bytes);
+        if (!write_copy(src, ss, hdr, out, bytes, cols)) {
+            return false;
+        }
+        ::unlink(uses.c_str());
+        ++promoted_;
+        return true;
+    }
+
+    // bytes held by every product under the cache root
+    uint64_t bytes() const {
+        uint64_t n = 0;
+        for (const Entry& e : scan()) {
+            n += e.bytes;
+        }
+        return n;
+    }
+
+    void describe(std::ostream& os) const {
+        os << "[hotcache] " << dir_.string() << " (" << (hugetlbfs_ ? "hugetlbfs" : "tmpfs") << "), "
+           << (bytes() >> 20) << " of " << (budget_ >> 20) << " MB, " << hits_ << " hits, " << misses_
+           << " misses, " << promoted_ << " promoted, " << evicted_ << " evicted";
+    }
+
+private:
+    static constexpr long SETTLE_S = 60;
+    static constexpr time_t MAX_USES = 1u << 20;
+
+    struct Entry {
+        fs::path path;
+        timespec used;
+        uint64_t bytes;
+    };
+
+    static void warn_once(const char* what) {
+        static std::atomic<bool> warned{false};
+        if (!warned.exchange(true, std::memory_order_relaxed)) {
+            std::fprintf(stderr, "[hotcache] %s\n", what);
+        }
+    }
+
+    static bool same_time(const timespec& a, const timespec& b) noexcept {
+        return a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec;
+    }
+
+    // the count lives in the marker's mtime seconds, hugetlbfs has no write() and only takes page sized truncates.
+    // flock keeps concurrent readers from losing counts
+    static uint32_t count_use(const fs::path& p) {
+        const int fd = ::open(p.c_str(), O_RDONLY | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return 0;
+        }
+        uint32_t n = 0;
+        struct stat st{};
+        if (::flock(fd, LOCK_EX) == 0 && ::fstat(fd, &st) == 0) {
+            // a fresh marker carries the current time, that is no count
+            n = st.st_mtim.tv_sec < MAX_USES ? static_cast<uint32_t>(st.st_mtim.tv_sec) + 1 : 1;
+            const timespec t[2] = {{0, UTIME_OMIT}, {static_cast<time_t>(n), 0}};
+            if (::futimens(fd, t) != 0) {
+                n = 0;
+            }
+        }
+        ::close(fd);
+        return n;
+    }
+
+    // capacity trimmed to the rows, columns on 2 MB boundaries, whole 2 MB pages so hugetlbfs takes the size
+    static uint64_t lay_out(Header& h) {
+        uint64_t off = HUGE_2MB;
+        h.capacity = h.rows;
+        h.layout = COL_LAYOUT_ALIGNED;
+        h.col_align = static_cast<uint32_t>(HUGE_2MB);
+        for (uint32_t c = 0; c < Schema::COLS; ++c) {
+            h.col_off[c] = off;
+            h.col_sz[c] = Schema::col_size(c);
+            off += round_up(h.rows * Schema::col_size(c), HUGE_2MB);
+        }
+        return off;
+    }
+
+    std::vector<Entry> scan() const {
+        std::vector<Entry> out;
+        std::error_code ec;
+        for (auto it = fs::recursive_directory_iterator(root_, ec); !ec && it != fs::recursive_directory_iterator();
+             it.increment(ec)) {
+            if (it->path().extension() != ".bin") {
+                continue;
+            }
+            struct stat st{};
+            if (::stat(it->path().c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+                out.push_back(Entry{it->path(), st.st_atim, static_cast<uint64_t>(st.st_size)});
+            }
+        }
+        return out;
+    }
+
+    // evicts least recently used copies, any product, until bytes more fit in the budget. readers that still map an
+    // evicted copy keep their pages until they unmap
+    void make_room(uint64_t bytes) {
+        std::vector<Entry> all = scan();
+        uint64_t used = 0;
+        for (const Entry& e : all) {
+            used += e.bytes;
+        }
+        std::sort(all.begin(), all.end(), [](const Entry& a, const Entry& b) {
+            return a.used.tv_sec != b.used.tv_sec ? a.used.tv_sec < b.used.tv_sec : a.used.tv_nsec < b.used.tv_nsec;
+        });
+        for (size_t i = 0; i < all.size() && used + bytes > budget_; ++i) {
+            if (::unlink(all[i].path.c_str()) == 0) {
+                used -= all[i].bytes;
+                ++evicted_;
+            }
+        }
+    }
+
+    // hugetlbfs has no write(), both file systems take ftruncate + fallocate + a shared mapping. fallocate
+    // reserves the pages up front, a full pool or mount fails here instead of with SIGBUS on a store
+    bool write_copy(const fs::path& src, const struct stat& ss, const Header& hdr, const Header& out, uint64_t bytes,
+                    const void* const* cols) {
+        const fs::path final_path = dir_ / src.filename();
+        const fs::path tmp = dir_ / ("." + src.filename().string() + "." + std::to_string(::getpid()) + "." +
+                                     std::to_string(reinterpret_cast<uintptr_t>(this)));
+        const int fd = ::open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        auto fail = [&](const char* what) {
+            ::close(fd);
+            ::unlink(tmp.c_str());
+            warn_once(what);
+            return false;
+        };
+        if (::ftruncate(fd, static_cast<off_t>(bytes)) != 0 || ::posix_fallocate(fd, 0, static_cast<off_t>(bytes)) != 0) {
+            return fail("out of space on the cache mount, day not promoted");
+        }
+        void* m = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (m == MAP_FAILED) {
+            return fail("cannot map a cache file, day not promoted");
+        }
+        auto* dst = static_cast<std::byte*>(m);
+
+        // columns the caller does not have come from a mapping of the source
+        const std::byte* src_map = nullptr;
+        for (uint32_t c = 0; c < Schema::COLS && !src_map; ++c) {
+            if (!cols[c]) {
+                const int sfd = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+                void* s = sfd >= 0 ? ::mmap(nullptr, static_cast<size_t>(ss.st_size), PROT_READ, MAP_SHARED, sfd, 0)
+                                   : MAP_FAILED;
+                if (sfd >= 0) {
+                    ::close(sfd);
+                }
+                if (s == MAP_FAILED) {
+                    ::munmap(m, bytes);
+                    return fail("cannot map the source day, day not promoted");
+                }
+                src_map = static_cast<const std::byte*>(s);
+                ::madvise(s, static_cast<size_t>(ss.st_size), MADV_SEQUENTIAL);
+            }
+        }
+        bool ok = true;
+        for (uint32_t c = 0; c < Schema::COLS; ++c) {
+            const uint64_t len = hdr.rows * Schema::col_size(c);
+            if (!cols[c] && hdr.col_off[c] + len > static_cast<uint64_t>(ss.st_size)) {
+                ok = false;
+                break;
+            }
+            const void* from = cols[c] ? cols[c] : src_map + hdr.col_off[c];
+            std::memcpy(dst + out.col_off[c], from, len);
+        }
+        std::memcpy(dst, &out, sizeof(out));
+        if (src_map) {
+            ::munmap(const_cast<std::byte*>(src_map), static_cast<size_t>(ss.st_size));
+        }
+        ::munmap(m, bytes);
+        if (!ok) {
+            return fail("source day shorter than its header, day not promoted");
+        }
+        // mtime pins the copy to this version of the source, atime is the lru clock
+        const timespec t[2] = {{0, UTIME_NOW}, ss.st_mtim};
+        ::futimens(fd, t);
+        ::close(fd);
+        if (::rename(tmp.c_str(), final_path.c_str()) != 0) {
+            ::unlink(tmp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    fs::path root_;
+    fs::path dir_;
+    uint64_t budget_;
+    uint32_t after_uses_;
+    bool ok_{false};
+    bool hugetlbfs_{false};
+    uint64_t hits_{0};
+    uint64_t misses_{0};
+    uint64_t promoted_{0};
+    uint64_t evicted_{0};
+};
@@ -0,0 +1,355 @@
+#pragma once
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+#include <algorithm>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifndef MAP_HUGETLB
+#define MAP_HUGETLB 0x40000 // 2mb
+#endif
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+// what to ask the kernel for, each choice falls back to the ones after it (1g -> 2m -> thp)
+enum class HugePage : uint8_t {
+    AUTO, // 1g pages once a request reaches half a gig, 2m below that
+    GB_1,
+    MB_2,
+    THP, // plain pages with MADV_HUGEPAGE, khugepaged may or may not collapse them
+};
+
+// what the kernel actually gave us, weakest last
+enum class HugeBacking : uint8_t {
+    GB_1,
+    MB_2,
+    THP,
+    NONE,
+};
+
+inline const char* backing_name(HugeBacking b) {
+    switch (b) {
+        case HugeBacking::GB_1:
+            return "hugetlb 1g";
+        case HugeBacking::MB_2:
+            return "hugetlb 2m";
+        case HugeBacking::THP:
+            return "4k + thp madvise";
+        default:
+            return "none";
+    }
+}
+
+static constexpr size_t HUGE_2MB = 2ull * 1024 * 1024;
+static constexpr size_t HUGE_1GB = 1024ull * 1024 * 1024;
+
+inline size_t round_up(size_t v, size_t to) { return (v + (to - 1)) & ~(to - 1); }
+
+// read only shared mapping of a file placed at a multiple of align, so file offsets that are multiples of align
+// land on addresses that are too and the kernel can map those ranges with pmd entries. MAP_FAILED on failure
+inline void* map_file_aligned(int fd, size_t bytes, size_t align) {
+    // the trims below have to start on page boundaries, the file mapping itself covers whole pages anyway
+    const size_t span = round_up(bytes, static_cast<size_t>(::sysconf(_SC_PAGESIZE)));
+    const size_t reserve = span + align;
+    void* p = ::mmap(nullptr, reserve, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) {
+        return p;
+    }
+    auto* raw = static_cast<std::byte*>(p);
+    auto* at = reinterpret_cast<std::byte*>(round_up(reinterpret_cast<uintptr_t>(raw), align));
+    void* m = ::mmap(at, bytes, PROT_READ, MAP_SHARED|MAP_FIXED, fd, 0);
+    if (m == MAP_FAILED) {
+        ::munmap(raw, reserve);
+        return m;
+    }
+    const size_t head = static_cast<size_t>(at - raw);
+    const size_t tail = reserve - head - span;
+    if ((head && ::munmap(raw, head) != 0) || (tail && ::munmap(at + span, tail) != 0)) {
+        const int err = errno;
+        ::munmap(raw, reserve);
+        errno = err;
+        return MAP_FAILED;
+    }
+    return m;
+}
+
+struct HugeBuff {
+    void* ptr{nullptr};
+    size_t len{0};
+    bool huge_tlb{false};
+    HugeBacking backing{HugeBacking::NONE};
+
+    static HugeBuff alloc(size_t bytes) { return alloc(bytes, HugePage::MB_2); }
+
+    static HugeBuff alloc(size_t bytes, HugePage page) {
+        HugeBuff buff;
+        if (page == HugePage::AUTO) {
+            page = bytes >= HUGE_1GB / 2 ? HugePage::GB_1 : HugePage::MB_2;
+        }
+        if (page == HugePage::GB_1) {
+            // bytes rounded up to the next multiple of huge page size (1g)
+            const size_t want = round_up(bytes, HUGE_1GB);
+            int flags = MAP_PRIVATE|MAP_ANONYMOUS|MAP_POPULATE|MAP_HUGETLB|MAP_HUGE_1GB;
+            if (void* p = ::mmap(nullptr, want, PROT_READ|PROT_WRITE, flags, -1, 0); p != MAP_FAILED) {
+                return HugeBuff{p, want, true, HugeBacking::GB_1};
+            }
+        }
+        if (page != HugePage::THP) {
+            // bytes rounded up to the next multiple of huge page size (2mb)
+            const size_t want = round_up(bytes, HUGE_2MB);
+            int flags = MAP_PRIVATE|MAP_ANONYMOUS|MAP_POPULATE|MAP_HUGETLB|MAP_HUGE_2MB;
+            if (void* p = ::mmap(nullptr, want, PROT_READ|PROT_WRITE, flags, -1, 0); p != MAP_FAILED) {
+                return HugeBuff{p, want, true, HugeBacking::MB_2};
+            }
+        }
+        if (void* p = ::mmap(nullptr, bytes, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+            p != MAP_FAILED) {
+            ::madvise(p, bytes, MADV_HUGEPAGE);
+            buff.ptr = p;
+            buff.len = bytes;
+            buff.backing = HugeBacking::THP;
+        }
+        return buff;
+    }
+
+    void free() {
+        if (ptr) {
+            munmap(ptr, len);
+            ptr = nullptr;
+            len = 0;
+            huge_tlb = false;
+            backing = HugeBacking::NONE;
+        }
+    }
+};
+
+// one contiguous range of address space reserved up front (PROT_NONE, costs no memory) and committed from the
+// front as it is needed. growth is geometric and never moves or frees what is already committed, so pointers
+// into it stay valid and a stage that saw a big day keeps its pages for the next one.
+// each commit tries hugetlb pages of the preferred size and falls back chunk by chunk, the first fallback in the
+// process is logged, describe() has the rest
+class HugeArena {
+public:
+    HugeArena(size_t va_bytes, HugePage page, double growth) : page_(page), growth_(std::max(1.0, growth)) {
+        va_ = round_up(std::max(va_bytes, HUGE_1GB), HUGE_1GB);
+        // over reserve by a gig so the base can be 1g aligned, 1g pages need that
+        const size_t span = va_ + HUGE_1GB;
+        void* p = ::mmap(nullptr, span, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+        if (p == MAP_FAILED) {
+            va_ = 0;
+            return;
+        }
+        auto* raw = static_cast<std::byte*>(p);
+        auto* aligned = reinterpret_cast<std::byte*>(round_up(reinterpret_cast<uintptr_t>(raw), HUGE_1GB));
+        if (aligned > raw) {
+            ::munmap(raw, static_cast<size_t>(aligned - raw));
+        }
+        const size_t tail = span - static_cast<size_t>(aligned - raw) - va_;
+        if (tail) {
+            ::munmap(aligned + va_, tail);
+        }
+        base_ = aligned;
+    }
+
+    ~HugeArena() {
+        if (base_) {
+            ::munmap(base_, va_);
+        }
+    }
+
+    HugeArena(const HugeArena&) = delete;
+    HugeArena& operator=(const HugeArena&) = delete;
+
+    std::byte* data() const noexcept { return base_; }
+    size_t committed() const noexcept { return committed_; }
+    size_t reserved() const noexcept { return va_; }
+
+    // weakest backing of any committed chunk, NONE while nothing is committed
+    HugeBacking backing() const noexcept {
+        HugeBacking b = HugeBacking::GB_1;
+        bool any = false;
+        for (uint32_t k = 0; k < N_BACKING; ++k) {
+            if (bytes_[k]) {
+                b = std::max(b, static_cast<HugeBacking>(k));
+                any = true;
+            }
+        }
+        return any ? b : HugeBacking::NONE;
+    }
+
+    size_t bytes_with(HugeBacking b) const noexcept {
+        return b == HugeBacking::NONE ? 0 : bytes_[static_cast<uint32_t>(b)];
+    }
+
+    // makes at least bytes usable, false when the reservation is too small or the kernel refuses even 4k pages
+    bool ensure(size_t bytes) {
+        if (bytes <= committed_) {
+            return true;
+        }
+        if (!base_ || bytes > va_) {
+            return false;
+        }
+        size_t target = std::max(bytes, static_cast<size_t>(static_cast<double>(committed_) * growth_));
+        target = std::min(round_up(target, HUGE_2MB), va_);
+
+        HugePage page = page_;
+        if (page == HugePage::AUTO) {
+            page = target >= HUGE_1GB / 2 ? HugePage::GB_1 : HugePage::MB_2;
+        }
+        while (committed_ < bytes) {
+            if (!commit(page, target - committed_)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void describe(std::ostream& os) const {
+        os << (committed_ >> 20) << " MB committed of " << (va_ >> 20) << " MB reserved";
+        for (uint32_t k = 0; k < N_BACKING; ++k) {
+            if (bytes_[k]) {
+                os << ", " << (bytes_[k] >> 20) << " MB " << backing_name(static_cast<HugeBacking>(k));
+            }
+        }
+    }
+
+private:
+    static constexpr uint32_t N_BACKING = static_cast<uint32_t>(HugeBacking::NONE);
+
+    // maps [committed_, committed_ + len) over the reservation with the best backing that works there
+    bool commit(HugePage page, size_t len) {
+        std::byte* at = base_ + committed_;
+        if (page == HugePage::GB_1 && committed_ % HUGE_1GB == 0 && committed_ + round_up(len, HUGE_1GB) <= va_) {
+            if (map_fixed(at, round_up(len, HUGE_1GB), MAP_HUGETLB|MAP_HUGE_1GB|MAP_POPULATE, HugeBacking::GB_1)) {
+                return true;
+            }
+        }
+        if (page != HugePage::THP) {
+            if (map_fixed(at, round_up(len, HUGE_2MB), MAP_HUGETLB|MAP_HUGE_2MB|MAP_POPULATE, HugeBacking::MB_2)) {
+                return true;
+            }
+        }
+        if (map_fixed(at, round_up(len, HUGE_2MB), 0, HugeBacking::THP)) {
+            ::madvise(at, round_up(len, HUGE_2MB), MADV_HUGEPAGE);
+            return true;
+        }
+        return false;
+    }
+
+    bool map_fixed(std::byte* at, size_t len, int extra, HugeBacking b) {
+        void* p = ::mmap(at, len, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_FIXED|extra, -1, 0);
+        if (p == MAP_FAILED) {
+            // put the reservation back in case the failed attempt tore it down
+            ::mmap(at, len, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE|MAP_FIXED, -1, 0);
+            static std::atomic<bool> warned{false};
+            if (b != HugeBacking::THP && !warned.exchange(true, std::memory_order_relaxed)) {
+                std::cerr << "[hugebuff] " << backing_name(b) << " unavailable for " << (len >> 20)
+                          << " MB, falling back" << std::endl;
+            }
+            return false;
+        }
+        bytes_[static_cast<uint32_t>(b)] += len;
+        committed_ += len;
+        return true;
+    }
+
+    std::byte* base_{nullptr};
+    size_t va_{0};
+    size_t committed_{0};
+    size_t bytes_[N_BACKING]{};
+    HugePage page_;
+    double growth_;
+};
+
+struct HugePoolOpt {
+    HugePage page{HugePage::AUTO};
+    size_t arena_va{64ull * HUGE_1GB}; // address space per arena, bounds the largest stage
+    double growth{2.0};
+    uint32_t reserve_arenas{0}; // committed in configure(), typically one per reader thread
+    size_t reserve_bytes{0}; // per reserved arena
+};
+
+// process wide free list of arenas. readers lease one when they first stage and hand it back when destroyed,
+// the next reader (another pipeline run, another worker) picks up the already faulted in pages
+class HugePool {
+public:
+    struct Return {
+        void operator()(HugeArena* a) const noexcept { instance().give_back(a); }
+    };
+    using Lease = std::unique_ptr<HugeArena, Return>;
+
+    // call once at startup before any reader stages, later calls only affect new arenas
+    static void configure(const HugePoolOpt& opt) {
+        HugePool& p = instance();
+        std::lock_guard<std::mutex> lk(p.mu_);
+        p.opt_ = opt;
+        for (uint32_t i = 0; i < opt.reserve_arenas; ++i) {
+            auto a = std::make_unique<HugeArena>(opt.arena_va, opt.page, opt.growth);
+            a->ensure(opt.reserve_bytes);
+            p.idle_.push_back(std::move(a));
+        }
+    }
+
+    // the idle arena with the most committed memory, a fresh one when none is idle
+    static Lease acquire() {
+        HugePool& p = instance();
+        std::lock_guard<std::mutex> lk(p.mu_);
+        if (p.idle_.empty()) {
+            ++p.created_;
+            return Lease(new HugeArena(p.opt_.arena_va, p.opt_.page, p.opt_.growth));
+        }
+        auto it = std::max_element(p.idle_.begin(), p.idle_.end(), [](const auto& a, const auto& b) {
+            return a->committed() < b->committed();
+        });
+        HugeArena* a = it->release();
+        p.idle_.erase(it);
+        return Lease(a);
+    }
+
+    static void report(std::ostream& os) {
+        HugePool& p = instance();
+        std::lock_guard<std::mutex> lk(p.mu_);
+        os << "[hugebuff] " << p.idle_.size() << " idle arenas, " << p.created_ << " created on demand\n";
+        for (const auto& a : p.idle_) {
+            os << "[hugebuff]   ";
+            a->describe(os);
+            os << '\n';
+        }
+        os.flush();
+    }
+
+private:
+    void give_back(HugeArena* a) {
+        std::lock_guard<std::mutex> lk(mu_);
+        idle_.emplace_back(a);
+    }
+
+    // never destroyed, leases held by static readers may come back during exit
+    static HugePool& instance() {
+        static HugePool* p = new HugePool();
+        return *p;
+    }
+
+    std::mutex mu_;
+    HugePoolOpt opt_{};
+    std::vector<std::unique_ptr<HugeArena>> idle_;
+    uint64_t created_{0};
+};
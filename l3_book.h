@@ -0,0 +1,537 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "reader.h"
+
+// action column of L3Schema
+enum class L3Action : uint8_t {
+    ADD = 0,
+    CANCEL = 1,
+    MODIFY = 2, // new price/size for a resting order
+    FILL = 3, // size is the filled amount
+    CLEAR = 4, // venue wiped the book
+};
+
+// aggregated book rebuilt from order level events. levels live in a dense array per side indexed by
+// price - base (recentred when a price falls outside), orders in an open addressing hash keyed by order id
+// with linear probing and backward shift deletion. side: 1 = bid, 0 = ask. a side spans at most max_levels ticks
+// of live levels, an order priced outside that (a bad print at 0 or UINT32_MAX) is dropped and counted in
+// unknown_events() instead of growing the array to the whole price range
+class L3Book {
+public:
+    static constexpr uint32_t DEFAULT_MAX_LEVELS = 1u << 20;
+
+    struct Order {
+        uint64_t id;
+        uint32_t px;
+        uint32_t sz;
+        uint8_t side;
+    };
+
+    explicit L3Book(uint32_t max_levels = DEFAULT_MAX_LEVELS)
+        : max_levels_(std::max<uint32_t>(max_levels, INITIAL_LEVELS)) {
+        clear();
+    }
+
+    void clear() {
+        for (Side& s : sides_) {
+            s.qty.clear();
+            s.orders.clear();
+            s.base = 0;
+            s.best = -1;
+        }
+        slots_.assign(INITIAL_SLOTS, Slot{});
+        mask_ = INITIAL_SLOTS - 1;
+        n_orders_ = 0;
+    }
+
+    void apply(uint64_t id, uint32_t px, uint32_t sz, uint8_t action, uint8_t side) {
+        switch (static_cast<L3Action>(action)) {
+        case L3Action::ADD:
+        case L3Action::MODIFY: {
+            Slot* o = find(id);
+            if (o) {
+                level_sub(o->side, o->px, o->sz, 1);
+                if (level_add(o->side, px, sz, 1)) {
+                    o->px = px;
+                    o->sz = sz;
+                }
+                else {
+                    erase(o);
+                    ++unknown_;
+                }
+            }
+            else if (level_add(side != 0, px, sz, 1)) {
+                insert(Slot{id, px, sz, static_cast<uint8_t>(side != 0), 1});
+            }
+            else {
+                ++unknown_;
+            }
+            break;
+        }
+        case L3Action::CANCEL: {
+            if (Slot* o = find(id)) {
+                level_sub(o->side, o->px, o->sz, 1);
+                erase(o);
+            }
+            else {
+                ++unknown_;
+            }
+            break;
+        }
+        case L3Action::FILL: {
+            if (Slot* o = find(id)) {
+                const uint32_t f = std::min(sz, o->sz);
+                o->sz -= f;
+                level_sub(o->side, o->px, f, o->sz == 0);
+                if (o->sz == 0) {
+                    erase(o);
+                }
+            }
+            else {
+                ++unknown_;
+            }
+            break;
+        }
+        case L3Action::CLEAR:
+            clear();
+            break;
+        default:
+            ++unknown_;
+            break;
+        }
+    }
+
+    // rows [from, to) of an L3 segment
+    void apply(const ReaderT<L3Schema>::Segment& seg, size_t from, size_t to) {
+        const auto* id = seg.col<uint64_t>(L3Schema::COL_ID);
+        const auto* px = seg.col<uint32_t>(L3Schema::COL_PX);
+        const auto* sz = seg.col<uint32_t>(L3Schema::COL_SZ);
+        const auto* act = seg.col<uint8_t>(L3Schema::COL_ACT);
+        const auto* side = seg.col<uint8_t>(L3Schema::COL_SIDE);
+        for (size_t i = from; i < to; ++i) {
+            apply(id[i], px[i], sz[i], act[i], side[i]);
+        }
+    }
+
+    bool has_bid() const noexcept { return sides_[1].best >= 0; }
+    bool has_ask() const noexcept { return sides_[0].best >= 0; }
+    uint32_t best_bid() const noexcept { return price_at(sides_[1]); }
+    uint32_t best_ask() const noexcept { return price_at(sides_[0]); }
+
+    uint64_t qty_at(uint8_t side, uint32_t px) const noexcept {
+        const Side& s = sides_[side != 0];
+        return (px >= s.base && px - s.base < s.qty.size()) ? s.qty[px - s.base] : 0;
+    }
+
+    // fn(uint32_t px, uint64_t qty, uint32_t orders) from the best level outwards, up to depth levels
+    template <class Fn>
+    void levels(uint8_t side, size_t depth, Fn&& fn) const {
+        const Side& s = sides_[side != 0];
+        const int64_t step = side ? -1 : 1;
+        for (int64_t i = s.best; i >= 0 && i < static_cast<int64_t>(s.qty.size()) && depth; i += step) {
+            if (s.qty[i]) {
+                fn(s.base + static_cast<uint32_t>(i), s.qty[i], s.orders[i]);
+                --depth;
+            }
+        }
+    }
+
+    // fn(const Order&) for every resting order, hash order
+    template <class Fn>
+    void orders(Fn&& fn) const {
+        for (const Slot& sl : slots_) {
+            if (sl.used) {
+                fn(Order{sl.id, sl.px, sl.sz, sl.side});
+            }
+        }
+    }
+
+    size_t n_orders() const noexcept { return n_orders_; }
+    // events for orders the book does not hold, unknown actions and orders dropped for a price out of reach
+    uint64_t unknown_events() const noexcept { return unknown_; }
+
+private:
+    static constexpr size_t INITIAL_SLOTS = 1u << 12;
+    static constexpr size_t INITIAL_LEVELS = 1u << 12;
+
+    struct Slot {
+        uint64_t id;
+        uint32_t px;
+        uint32_t sz;
+        uint8_t side;
+        uint8_t used;
+    };
+
+    struct Side {
+        std::vector<uint64_t> qty;
+        std::vector<uint32_t> orders;
+        uint32_t base{0}; // price of index 0
+        int64_t best{-1}; // index of the best non empty level, -1 when empty
+    };
+
+    static uint32_t price_at(const Side& s) noexcept {
+        return s.best >= 0 ? s.base + static_cast<uint32_t>(s.best) : 0;
+    }
+
+    size_t home(uint64_t id) const noexcept {
+        return static_cast<size_t>((id * 0x9E3779B97F4A7C15ull) >> 32) & mask_;
+    }
+
+    Slot* find(uint64_t id) noexcept {
+        for (size_t i = home(id);; i = (i + 1) & mask_) {
+            Slot& s = slots_[i];
+            if (!s.used) {
+                return nullptr;
+            }
+            if (s.id == id) {
+                return &s;
+            }
+        }
+    }
+
+    void insert(const Slot& v) {
+        if ((n_orders_ + 1) * 2 > slots_.size()) {
+            rehash(slots_.size() * 2);
+        }
+        size_t i = home(v.id);
+        while (slots_[i].used) {
+            i = (i + 1) & mask_;
+        }
+        slots_[i] = v;
+        ++n_orders_;
+    }
+
+    // backward shift, keeps probe chains intact without tombstones
+    void erase(Slot* s) noexcept {
+        size_t hole = static_cast<size_t>(s - slots_.data());
+        for (size_t i = (hole + 1) & mask_; slots_[i].used; i = (i + 1) & mask_) {
+            const size_t h = home(slots_[i].id);
+            // move i into the hole unless its home lies cyclically in (hole, i]
+            if (((i - h) & mask_) >= ((i - hole) & mask_)) {
+                slots_[hole] = slots_[i];
+                hole = i;
+            }
+        }
+        slots_[hole].used = 0;
+        --n_orders_;
+    }
+
+    void rehash(size_t n_slots) {
+        std::vector<Slot> old;
+        old.swap(slots_);
+        slots_.assign(n_slots, Slot{});
+        mask_ = n_slots - 1;
+        n_orders_ = 0;
+        for (const Slot& s : old) {
+            if (s.used) {
+                insert(s);
+            }
+        }
+    }
+
+    // makes px addressable, recentres the array around the old range plus px. when that would span more than
+    // max_levels_ the empty ends are dropped, false if the live levels plus px still do not fit
+    bool reach(Side& s, uint32_t px) {
+        if (s.qty.empty()) {
+            s.qty.assign(INITIAL_LEVELS, 0);
+            s.orders.assign(INITIAL_LEVELS, 0);
+            s.base = px > INITIAL_LEVELS / 2 ? px - static_cast<uint32_t>(INITIAL_LEVELS / 2) : 0;
+            return true;
+        }
+        if (px >= s.base && px - s.base < s.qty.size()) {
+            return true;
+        }
+        uint64_t lo = std::min<uint64_t>(s.base, px);
+        uint64_t hi = std::max<uint64_t>(s.base + s.qty.size(), static_cast<uint64_t>(px) + 1);
+        if (hi - lo > max_levels_) {
+            // prices drift over a day, only the live levels have to stay addressable
+            size_t first = 0;
+            size_t last = s.orders.size();
+            while (first < last && s.orders[first] == 0) {
+                ++first;
+            }
+            while (last > first && s.orders[last - 1] == 0) {
+                --last;
+            }
+            lo = first < last ? std::min<uint64_t>(s.base + first, px) : px;
+            hi = first < last ? std::max<uint64_t>(s.base + last, static_cast<uint64_t>(px) + 1) : px + 1ull;
+            if (hi - lo > max_levels_) {
+                return false;
+            }
+        }
+        size_t size = INITIAL_LEVELS;
+        while (size < 2 * (hi - lo) && size < max_levels_) {
+            size *= 2;
+        }
+        const uint64_t slack = (size - (hi - lo)) / 2;
+        const uint32_t base = static_cast<uint32_t>(lo > slack ? lo - slack : 0);
+
+        // every live level lies in [lo, hi), which the new array covers
+        std::vector<uint64_t> qty(size, 0);
+        std::vector<uint32_t> orders(size, 0);
+        for (size_t i = 0; i < s.orders.size(); ++i) {
+            if (s.orders[i]) {
+                const size_t j = static_cast<size_t>(s.base + i - base);
+                qty[j] = s.qty[i];
+                orders[j] = s.orders[i];
+            }
+        }
+        s.qty.swap(qty);
+        s.orders.swap(orders);
+        if (s.best >= 0) {
+            s.best = static_cast<int64_t>(s.base + static_cast<uint64_t>(s.best) - base);
+        }
+        s.base = base;
+        return true;
+    }
+
+    // false when px is out of reach, nothing is booked then
+    bool level_add(uint8_t side, uint32_t px, uint32_t sz, uint32_t n) {
+        Side& s = sides_[side];
+        if (!reach(s, px)) {
+            return false;
+        }
+        const int64_t i = px - s.base;
+        s.qty[i] += sz;
+        s.orders[i] += n;
+        if (s.best < 0 || (side ? i > s.best : i < s.best)) {
+            s.best = i;
+        }
+        return true;
+    }
+
+    void level_sub(uint8_t side, uint32_t px, uint32_t sz, uint32_t n) {
+        Side& s = sides_[side];
+        const int64_t i = px - s.base;
+        s.qty[i] -= std::min<uint64_t>(s.qty[i], sz);
+        s.orders[i] -= std::min(s.orders[i], n);
+        if (s.orders[i] == 0) {
+            s.qty[i] = 0;
+        }
+        if (i == s.best && s.orders[i] == 0) {
+            // walk away from the touch to the next live level
+            const int64_t step = side ? -1 : 1;
+            int64_t k = i + step;
+            while (k >= 0 && k < static_cast<int64_t>(s.qty.size()) && s.orders[k] == 0) {
+                k += step;
+            }
+            s.best = (k >= 0 && k < static_cast<int64_t>(s.qty.size())) ? k : -1;
+        }
+    }
+
+    Side sides_[2]; // ask = 0, bid = 1
+    uint32_t max_levels_;
+    std::vector<Slot> slots_;
+    size_t mask_{0};
+    size_t n_orders_{0};
+    uint64_t unknown_{0};
+};
+
+static constexpr uint32_t L3_SNAP_VERSION = 2;
+
+#pragma pack(push, 1)
+// <day>.snap next to <day>.bin: [SnapFileHeader][orders of snap 0][orders of snap 1]...[SnapIndexEntry x n_snaps]
+struct SnapFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t yyyymmdd;
+    uint64_t index_off;
+    uint32_t n_snaps;
+    uint32_t reserved0;
+    // the day file the snapshots were built from, a sidecar that disagrees with the current file is ignored
+    uint64_t src_rows;
+    uint64_t src_bytes;
+    int64_t src_mtime_ns;
+};
+
+// book state after rows [0, next_row), valid from ts_ns until the ts of row next_row
+struct SnapIndexEntry {
+    uint64_t ts_ns;
+    uint64_t next_row;
+    uint64_t off;
+    uint32_t n_orders;
+    uint32_t reserved0;
+};
+
+struct SnapOrder {
+    uint64_t id;
+    uint32_t px;
+    uint32_t sz;
+    uint8_t side;
+};
+#pragma pack(pop)
+
+// writes book checkpoints every every_ns while replaying, and seeks into a day from the nearest one
+class L3Snapshots {
+public:
+    static constexpr char MAGIC[8] = {'L', '3', 'S', 'N', 'A', 'P', '\n', '\0'};
+
+    static fs::path snap_path(const fs::path& day_file) {
+        fs::path p = day_file;
+        p.replace_extension(".snap");
+        return p;
+    }
+
+    // replays every day of opt and writes its sidecar, returns the number of snapshots written
+    static size_t build(const ReaderOpt& opt, uint64_t every_ns) {
+        if (every_ns == 0) {
+            throw std::runtime_error("[l3snap] snapshot interval must be > 0");
+        }
+        ReaderT<L3Schema> reader(opt);
+        size_t total = 0;
+        for (size_t k = 0; k < reader.days().size(); ++k) {
+            const fs::path day = reader.paths()[k];
+            const uint32_t yyyymmdd = reader.days()[k];
+            reader.visit_single_segment(day, [&](const ReaderT<L3Schema>::Segment& seg) {
+                total += build_day(seg, day, yyyymmdd, every_ns);
+            });
+        }
+        return total;
+    }
+
+    // seg is day_file mapped or staged, the sidecar goes to snap_path(day_file)
+    static size_t build_day(const ReaderT<L3Schema>::Segment& seg, const fs::path& day_file, uint32_t yyyymmdd,
+                            uint64_t every_ns) {
+        const fs::path out = snap_path(day_file);
+        const auto* ts = seg.col<uint64_t>(L3Schema::COL_TS);
+        L3Book book;
+        std::vector<SnapIndexEntry> index;
+        std::vector<SnapOrder> orders;
+
+        const fs::path tmp = fs::path(out.string() + ".tmp");
+        const int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("[l3snap] open failed");
+        }
+        SnapFileHeader hdr{};
+        std::memcpy(hdr.magic, MAGIC, sizeof(MAGIC));
+        hdr.version = L3_SNAP_VERSION;
+        hdr.yyyymmdd = yyyymmdd;
+        hdr.src_rows = seg.rows;
+        uint64_t off = sizeof(hdr);
+        bool ok = stamp(day_file, hdr.src_bytes, hdr.src_mtime_ns);
+
+        size_t i = 0;
+        while (i < seg.rows && ok) {
+            const uint64_t next = (ts[i] / every_ns + 1) * every_ns;
+            const size_t j = static_cast<size_t>(std::lower_bound(ts + i, ts + seg.rows, next) - ts);
+            book.apply(seg, i, j);
+            i = j;
+            if (i == seg.rows) {
+                break;
+            }
+            orders.clear();
+            book.orders([&](const L3Book::Order& o) { orders.push_back(SnapOrder{o.id, o.px, o.sz, o.side}); });
+            const size_t bytes = orders.size() * sizeof(SnapOrder);
+            ok = bytes == 0 || ::pwrite(fd, orders.data(), bytes, static_cast<off_t>(off)) == static_cast<ssize_t>(bytes);
+            index.push_back(SnapIndexEntry{next, i, off, static_cast<uint32_t>(orders.size()), 0});
+            off += bytes;
+        }
+
+        hdr.index_off = off;
+        hdr.n_snaps = static_cast<uint32_t>(index.size());
+        const size_t ibytes = index.size() * sizeof(SnapIndexEntry);
+        ok = ok && (ibytes == 0 || ::pwrite(fd, index.data(), ibytes, static_cast<off_t>(off)) ==
+                                       static_cast<ssize_t>(ibytes));
+        ok = ok && ::pwrite(fd, &hdr, sizeof(hdr), 0) == static_cast<ssize_t>(sizeof(hdr));
+        ok = ok && ::fdatasync(fd) == 0;
+        ::close(fd);
+        if (!ok || ::rename(tmp.c_str(), out.c_str()) != 0) {
+            ::unlink(tmp.c_str());
+            throw std::runtime_error("[l3snap] write failed");
+        }
+        return index.size();
+    }
+
+    // book as of ts_ns (every row with ts <= ts_ns applied), returns the next row to replay. seg is day_file mapped
+    // or staged. falls back to a replay from the open when the sidecar is missing, was built from another version
+    // of the day file or has no earlier snapshot
+    static size_t seek(const ReaderT<L3Schema>::Segment& seg, const fs::path& day_file, uint64_t ts_ns,
+                       L3Book& book) {
+        book.clear();
+        const size_t row = load_nearest(snap_path(day_file), day_file, seg.rows, ts_ns, book);
+        const auto* ts = seg.col<uint64_t>(L3Schema::COL_TS);
+        const size_t end = static_cast<size_t>(std::upper_bound(ts + row, ts + seg.rows, ts_ns) - ts);
+        book.apply(seg, row, end);
+        return end;
+    }
+
+private:
+    static bool stamp(const fs::path& day_file, uint64_t& bytes, int64_t& mtime_ns) {
+        struct stat st{};
+        if (::stat(day_file.c_str(), &st) != 0) {
+            return false;
+        }
+        bytes = static_cast<uint64_t>(st.st_size);
+        mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1'000'000'000ll + st.st_mtim.tv_nsec;
+        return true;
+    }
+
+    static size_t load_nearest(const fs::path& snap, const fs::path& day_file, uint64_t day_rows, uint64_t ts_ns,
+                               L3Book& book) {
+        uint64_t day_bytes = 0;
+        int64_t day_mtime_ns = 0;
+        if (!stamp(day_file, day_bytes, day_mtime_ns)) {
+            return 0;
+        }
+        const int fd = ::open(snap.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return 0;
+        }
+        struct stat st{};
+        if (::fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(SnapFileHeader))) {
+            ::close(fd);
+            return 0;
+        }
+        const size_t bytes = static_cast<size_t>(st.st_size);
+        void* m = ::mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (m == MAP_FAILED) {
+            return 0;
+        }
+        const auto* base = static_cast<const uint8_t*>(m);
+
+        SnapFileHeader hdr{};
+        std::memcpy(&hdr, base, sizeof(hdr));
+        size_t row = 0;
+        const size_t ibytes = static_cast<size_t>(hdr.n_snaps) * sizeof(SnapIndexEntry);
+        if (std::memcmp(hdr.magic, MAGIC, sizeof(MAGIC)) == 0 && hdr.version == L3_SNAP_VERSION &&
+            hdr.src_rows == day_rows && hdr.src_bytes == day_bytes && hdr.src_mtime_ns == day_mtime_ns &&
+            hdr.index_off <= bytes && ibytes <= bytes - hdr.index_off) {
+            // last snapshot taken at or before ts_ns
+            SnapIndexEntry pick{};
+            bool found = false;
+            for (uint32_t k = 0; k < hdr.n_snaps; ++k) {
+                SnapIndexEntry e;
+                std::memcpy(&e, base + hdr.index_off + k * sizeof(SnapIndexEntry), sizeof(e));
+                if (e.ts_ns > ts_ns) {
+                    break;
+                }
+                pick = e;
+                found = true;
+            }
+            if (found && pick.next_row <= day_rows && pick.off <= hdr.index_off &&
+                static_cast<uint64_t>(pick.n_orders) * sizeof(SnapOrder) <= hdr.index_off - pick.off) {
+                for (uint32_t k = 0; k < pick.n_orders; ++k) {
+                    SnapOrder o;
+                    std::memcpy(&o, base + pick.off + k * sizeof(SnapOrder), sizeof(o));
+                    book.apply(o.id, o.px, o.sz, static_cast<uint8_t>(L3Action::ADD), o.side);
+                }
+                row = pick.next_row;
+            }
+        }
+        ::munmap(m, bytes);
+        return row;
+    }
+};
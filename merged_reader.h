@@ -0,0 +1,236 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <algorithm>
+#include "reader.h"
+
+struct MergedReaderOpt {
+    std::string base_dir;
+    std::vector<std::string> products; // one per schema, in template argument order
+    uint32_t date_from = 0;
+    uint32_t date_to = 99999999;
+    uint32_t batch_rows{4096};
+};
+
+// tournament tree of losers over k sorted sources, the winner is the smallest key, ties go to the lower source so
+// the merge is stable by product index. replay only walks the winner's leaf to root path
+class LoserTree {
+public:
+    static constexpr uint64_t DONE = ~0ull;
+
+    void build(const uint64_t* keys, uint32_t k) {
+        leaves_ = 1;
+        while (leaves_ < k) {
+            leaves_ <<= 1;
+        }
+        keys_.assign(leaves_, DONE);
+        std::copy(keys, keys + k, keys_.begin());
+        tree_.assign(leaves_, 0);
+
+        // winners bottom up, each internal node keeps the loser
+        std::vector<uint32_t> win(2 * leaves_);
+        for (uint32_t i = 0; i < leaves_; ++i) {
+            win[leaves_ + i] = i;
+        }
+        for (uint32_t n = leaves_ - 1; n >= 1; --n) {
+            const uint32_t a = win[2 * n];
+            const uint32_t b = win[2 * n + 1];
+            const bool a_wins = less(a, b);
+            win[n] = a_wins ? a : b;
+            tree_[n] = a_wins ? b : a;
+        }
+        winner_ = leaves_ > 1 ? win[1] : 0;
+    }
+
+    uint32_t winner() const noexcept { return winner_; }
+    uint64_t key(uint32_t s) const noexcept { return keys_[s]; }
+
+    // new key for the current winner, then replay its path
+    void replace_winner(uint64_t key) noexcept {
+        uint32_t w = winner_;
+        keys_[w] = key;
+        for (uint32_t n = (w + leaves_) >> 1; n >= 1; n >>= 1) {
+            const uint32_t l = tree_[n];
+            const bool l_wins = less(l, w);
+            tree_[n] = l_wins ? w : l;
+            w = l_wins ? l : w;
+        }
+        winner_ = w;
+    }
+
+private:
+    bool less(uint32_t a, uint32_t b) const noexcept {
+        const uint64_t ka = keys_[a];
+        const uint64_t kb = keys_[b];
+        return (ka < kb) | ((ka == kb) & (a < b));
+    }
+
+    uint32_t leaves_{1};
+    uint32_t winner_{0};
+    std::vector<uint64_t> keys_;
+    std::vector<uint32_t> tree_;
+};
+
+// opens one ReaderT per product over the same date range and replays them merged by ts_ns, day by day.
+// schemas may differ per product, batches only carry (ts, product, row) and point back into the staged segments
+template <class... Schemas>
+class MergedReader {
+public:
+    static constexpr uint32_t N = sizeof...(Schemas);
+    static_assert(N >= 1 && N <= 255, "[mergedreader] 1..255 products");
+
+    template <size_t I>
+    using SchemaAt = std::tuple_element_t<I, std::tuple<Schemas...>>;
+    template <size_t I>
+    using SegmentAt = typename ReaderT<SchemaAt<I>>::Segment;
+
+    struct Batch {
+        uint32_t yyyymmdd;
+        size_t n;
+        const uint64_t* ts;
+        const uint8_t* product; // index into MergedReaderOpt::products
+        const uint32_t* row; // row of that product's segment
+        const std::tuple<typename ReaderT<Schemas>::Segment...>* segs;
+
+        template <size_t I>
+        const SegmentAt<I>& segment() const noexcept { return std::get<I>(*segs); }
+
+        // only valid when product[i] == I
+        template <size_t I>
+        typename SchemaAt<I>::Row row_at(size_t i) const noexcept {
+            typename SchemaAt<I>::Row r{};
+            SchemaAt<I>::read_row_from_cols(r, segment<I>().col_ptrs, row[i]);
+            return r;
+        }
+    };
+
+    explicit MergedReader(const MergedReaderOpt& opt) : opt_(opt) {
+        if (opt_.products.size() != N) {
+            throw std::runtime_error("[mergedreader] need one product per schema");
+        }
+        if (opt_.batch_rows == 0) {
+            throw std::runtime_error("[mergedreader] batch_rows must be > 0");
+        }
+        open_readers(std::index_sequence_for<Schemas...>{});
+        ts_.resize(opt_.batch_rows);
+        product_.resize(opt_.batch_rows);
+        row_.resize(opt_.batch_rows);
+    }
+
+    // union of the products' days, a product missing a day just doesn't contribute to it
+    const std::vector<uint32_t>& days() const noexcept { return days_; }
+
+    // fn(const Batch&), return false to stop early
+    template <class Fn>
+    void visit_batches(Fn&& fn) {
+        for (uint32_t d : days_) {
+            if (!merge_day(d, fn)) {
+                return;
+            }
+        }
+    }
+
+private:
+    template <size_t... I>
+    void open_readers(std::index_sequence<I...>) {
+        ((std::get<I>(readers_) = std::make_unique<ReaderT<SchemaAt<I>>>(reader_opt(I))), ...);
+        (collect_days(std::get<I>(readers_)->days()), ...);
+        std::sort(days_.begin(), days_.end());
+        days_.erase(std::unique(days_.begin(), days_.end()), days_.end());
+    }
+
+    ReaderOpt reader_opt(size_t i) const {
+        ReaderOpt ro;
+        ro.base_dir = opt_.base_dir;
+        ro.product = opt_.products[i];
+        ro.date_from = opt_.date_from;
+        ro.date_to = opt_.date_to;
+        return ro;
+    }
+
+    void collect_days(const std::vector<uint32_t>& d) { days_.insert(days_.end(), d.begin(), d.end()); }
+
+    template <size_t I>
+    void stage_one(uint32_t day) {
+        auto& reader = *std::get<I>(readers_);
+        auto& seg = std::get<I>(segs_);
+        seg = {};
+        src_ts_[I] = nullptr;
+        src_rows_[I] = 0;
+        const auto& d = reader.days();
+        const auto it = std::lower_bound(d.begin(), d.end(), day);
+        if (it == d.end() || *it != day || !reader.stage_day(static_cast<size_t>(it - d.begin()), seg)) {
+            return;
+        }
+        src_ts_[I] = seg.template col<uint64_t>(SchemaAt<I>::COL_TS);
+        src_rows_[I] = seg.rows;
+    }
+
+    template <size_t... I>
+    void stage_all(uint32_t day, std::index_sequence<I...>) {
+        (stage_one<I>(day), ...);
+    }
+
+    template <class Fn>
+    bool emit(uint32_t day, size_t n, Fn& fn) {
+        const Batch b{day, n, ts_.data(), product_.data(), row_.data(), &segs_};
+        if constexpr (std::is_same_v<std::invoke_result_t<Fn&, const Batch&>, bool>) {
+            return fn(b);
+        }
+        else {
+            fn(b);
+            return true;
+        }
+    }
+
+    template <class Fn>
+    bool merge_day(uint32_t day, Fn& fn) {
+        stage_all(day, std::index_sequence_for<Schemas...>{});
+
+        uint64_t keys[N];
+        uint64_t remaining = 0;
+        for (uint32_t p = 0; p < N; ++p) {
+            pos_[p] = 0;
+            keys[p] = src_rows_[p] ? src_ts_[p][0] : LoserTree::DONE;
+            remaining += src_rows_[p];
+        }
+        tree_.build(keys, N);
+
+        const size_t cap = opt_.batch_rows;
+        size_t n = 0;
+        for (; remaining > 0; --remaining) {
+            const uint32_t w = tree_.winner();
+            const uint64_t i = pos_[w]++;
+            ts_[n] = tree_.key(w);
+            product_[n] = static_cast<uint8_t>(w);
+            row_[n] = static_cast<uint32_t>(i);
+            tree_.replace_winner(i + 1 < src_rows_[w] ? src_ts_[w][i + 1] : LoserTree::DONE);
+            if (++n == cap) {
+                if (!emit(day, n, fn)) {
+                    return false;
+                }
+                n = 0;
+            }
+        }
+        return n == 0 || emit(day, n, fn);
+    }
+
+    MergedReaderOpt opt_;
+    std::tuple<std::unique_ptr<ReaderT<Schemas>>...> readers_;
+    std::tuple<typename ReaderT<Schemas>::Segment...> segs_;
+    std::vector<uint32_t> days_;
+    const uint64_t* src_ts_[N]{};
+    uint64_t src_rows_[N]{};
+    uint64_t pos_[N]{};
+    LoserTree tree_;
+    std::vector<uint64_t> ts_;
+    std::vector<uint8_t> product_;
+    std::vector<uint32_t> row_;
+};
@@ -0,0 +1,208 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+#include "reader.h"
+
+// replays the days of one product on a pool of workers, each worker owns a ReaderT and so its own HugeBuff stage.
+// days are dealt largest first (catalog row count, file size without a catalog) into per worker deques,
+// workers pop their own front and steal from the back of the others once they run dry
+template <class Schema>
+class ParallelReaderT {
+public:
+    using Reader = ReaderT<Schema>;
+    using Segment = typename Reader::Segment;
+
+    explicit ParallelReaderT(const ReaderOpt& opt, uint32_t threads = 0) {
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        readers_.push_back(std::make_unique<Reader>(opt));
+        const size_t n_days = readers_[0]->days().size();
+        const uint32_t workers = static_cast<uint32_t>(std::max<size_t>(1, std::min<size_t>(threads, n_days)));
+        for (uint32_t w = 1; w < workers; ++w) {
+            readers_.push_back(std::make_unique<Reader>(opt));
+            if (readers_[w]->days() != readers_[0]->days()) {
+                throw std::runtime_error("[parallelreader] day list changed while planning");
+            }
+        }
+        plan_order();
+    }
+
+    uint32_t workers() const noexcept { return static_cast<uint32_t>(readers_.size()); }
+    const std::vector<uint32_t>& days() const noexcept { return readers_[0]->days(); }
+
+    // fn(uint32_t worker, uint32_t yyyymmdd, const Segment&) runs concurrently, once per non empty day
+    template <class Fn>
+    void visit_days(Fn&& fn) {
+        const auto& d = days();
+        run([&](uint32_t w, size_t k, const Segment* seg) {
+            if (seg) {
+                HFT_PERF_PHASE(VISIT);
+                fn(w, d[k], *seg);
+            }
+        });
+    }
+
+    // fn returns a per day result, reduce(uint32_t yyyymmdd, R&&) gets them in day order and never concurrently,
+    // as soon as every earlier day is done
+    template <class Fn, class Reduce>
+    void visit_days(Fn&& fn, Reduce&& reduce) {
+        using R = std::invoke_result_t<Fn&, uint32_t, uint32_t, const Segment&>;
+        const auto& d = days();
+        const size_t n = d.size();
+        std::vector<std::optional<R>> results(n);
+        std::vector<uint8_t> done(n, 0);
+        size_t next = 0;
+        std::mutex reduce_mu;
+
+        run([&](uint32_t w, size_t k, const Segment* seg) {
+            std::optional<R> r;
+            if (seg) {
+                HFT_PERF_PHASE(VISIT);
+                r.emplace(fn(w, d[k], *seg));
+            }
+            std::lock_guard<std::mutex> lk(reduce_mu);
+            results[k] = std::move(r);
+            done[k] = 1;
+            for (; next < n && done[next]; ++next) {
+                if (results[next]) {
+                    reduce(d[next], std::move(*results[next]));
+                    results[next].reset();
+                }
+            }
+        });
+    }
+
+    // fn(uint32_t worker, uint32_t yyyymmdd, const Segment&) per window of ReaderOpt::stage_window_bytes, windows of
+    // one day arrive in row order on one worker, stage memory stays at a window per worker however big the days
+    template <class Fn>
+    void visit_windows(Fn&& fn) {
+        const auto& d = days();
+        schedule([&](uint32_t w, size_t k) {
+            readers_[w]->stage_day_windows(k, [&](const Segment& seg) {
+                fn(w, d[k], seg);
+                return true;
+            });
+        });
+    }
+
+private:
+    struct WorkQueue {
+        std::mutex mu;
+        std::deque<size_t> days;
+    };
+
+    void plan_order() {
+        const Reader& r = *readers_[0];
+        const size_t n = r.days().size();
+        std::vector<uint64_t> weight(n);
+        for (size_t k = 0; k < n; ++k) {
+            weight[k] = r.day_rows()[k];
+            if (weight[k] == 0) {
+                std::error_code ec;
+                const auto sz = std::filesystem::file_size(r.paths()[k], ec);
+                weight[k] = ec ? 0 : static_cast<uint64_t>(sz);
+            }
+        }
+        order_.resize(n);
+        for (size_t k = 0; k < n; ++k) {
+            order_[k] = k;
+        }
+        std::stable_sort(order_.begin(), order_.end(), [&](size_t a, size_t b) { return weight[a] > weight[b]; });
+    }
+
+    bool pop(std::vector<WorkQueue>& queues, uint32_t w, size_t& k) {
+        {
+            WorkQueue& own = queues[w];
+            std::lock_guard<std::mutex> lk(own.mu);
+            if (!own.days.empty()) {
+                k = own.days.front();
+                own.days.pop_front();
+                return true;
+            }
+        }
+        const uint32_t nw = static_cast<uint32_t>(queues.size());
+        for (uint32_t i = 1; i < nw; ++i) {
+            WorkQueue& victim = queues[(w + i) % nw];
+            std::lock_guard<std::mutex> lk(victim.mu);
+            if (!victim.days.empty()) {
+                k = victim.days.back();
+                victim.days.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // body(worker, day index, segment or nullptr when the day could not be staged)
+    template <class Body>
+    void run(Body&& body) {
+        schedule([&](uint32_t w, size_t k) {
+            Segment seg{};
+            const bool staged = readers_[w]->stage_day(k, seg);
+            body(w, k, staged ? &seg : nullptr);
+        });
+    }
+
+    // body(worker, day index) once per day, largest days first with stealing, first exception is rethrown
+    template <class Body>
+    void schedule(Body&& body) {
+        const uint32_t nw = workers();
+        std::vector<WorkQueue> queues(nw);
+        for (size_t i = 0; i < order_.size(); ++i) {
+            queues[i % nw].days.push_back(order_[i]);
+        }
+
+        std::atomic<bool> failed{false};
+        std::exception_ptr error;
+        std::mutex error_mu;
+
+        auto work = [&](uint32_t w) {
+            size_t k = 0;
+            while (!failed.load(std::memory_order_acquire) && pop(queues, w, k)) {
+                try {
+                    body(w, k);
+                }
+                catch (...) {
+                    std::lock_guard<std::mutex> lk(error_mu);
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                    failed.store(true, std::memory_order_release);
+                }
+            }
+        };
+
+        std::vector<std::thread> pool;
+        pool.reserve(nw - 1);
+        for (uint32_t w = 1; w < nw; ++w) {
+            pool.emplace_back(work, w);
+        }
+        work(0);
+        for (auto& t : pool) {
+            t.join();
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    std::vector<std::unique_ptr<Reader>> readers_;
+    std::vector<size_t> order_;
+};
+
+using L2ParallelReader = ParallelReaderT<L2Schema>;
+using L3ParallelReader = ParallelReaderT<L3Schema>;
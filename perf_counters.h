@@ -0,0 +1,343 @@
+#pragma once
+#include <cstdint>
+
+// hardware counters attributed to reader/writer phases, compiled in with -DHFT_PERF_COUNTERS only.
+// without it HFT_PERF_PHASE and HFT_PERF_REPORT expand to nothing and this header pulls in no code.
+// counts are inclusive (a phase nested in another shows up in both) and per thread, summed in the report.
+// every scope costs two read() syscalls, fine around files and blocks, too much around single rows
+
+enum class PerfPhase : uint8_t {
+    MAPPING,
+    STAGING,
+    VISIT, // user callback
+    DECODE_BLOCK,
+    APPEND_BLOCK,
+    GROW_FILE,
+    COUNT
+};
+
+#if defined(HFT_PERF_COUNTERS)
+
+#include <atomic>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <mutex>
+#include <ostream>
+#include <vector>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+class PerfCounters {
+public:
+    enum Event : uint32_t { CYCLES, INSTRUCTIONS, DTLB_LOAD_MISSES, LLC_MISSES, PAGE_FAULTS, N_EVENTS };
+
+    static constexpr uint32_t N_PHASES = static_cast<uint32_t>(PerfPhase::COUNT);
+
+    static const char* phase_name(PerfPhase p) {
+        static constexpr const char* names[N_PHASES] = {"map_file", "stage_curr_file", "visit", "decode_block",
+                                                        "append_rows_as_block", "grow_file"};
+        return names[static_cast<uint32_t>(p)];
+    }
+
+    static const char* event_name(uint32_t e) {
+        static constexpr const char* names[N_EVENTS] = {"cycles", "instructions", "dTLB-load-misses", "LLC-misses",
+                                                        "page-faults"};
+        return names[e];
+    }
+
+    struct Totals {
+        uint64_t calls{0};
+        uint64_t ns{0};
+        uint64_t ev[N_EVENTS]{};
+    };
+
+    // one counter group per thread, opened on the first phase the thread enters
+    class Thread {
+    public:
+        struct Sample {
+            uint64_t ns;
+            uint64_t ev[N_EVENTS];
+        };
+
+        Thread() {
+            open_group();
+            registry().attach(this);
+        }
+
+        ~Thread() {
+            registry().detach(this);
+            for (int fd : fds_) {
+                if (fd >= 0) {
+                    ::close(fd);
+                }
+            }
+        }
+
+        Thread(const Thread&) = delete;
+        Thread& operator=(const Thread&) = delete;
+
+        void sample(Sample& s) const {
+            std::memset(s.ev, 0, sizeof(s.ev));
+            if (n_open_) {
+                // PERF_FORMAT_GROUP: nr, then one value per member in open order
+                uint64_t buf[1 + N_EVENTS]{};
+                if (::read(fds_[0], buf, sizeof(buf)) > 0) {
+                    for (uint32_t i = 0; i < n_open_ && i < buf[0]; ++i) {
+                        s.ev[slot_[i]] = buf[1 + i];
+                    }
+                }
+            }
+            timespec ts{};
+            ::clock_gettime(CLOCK_MONOTONIC, &ts);
+            s.ns = static_cast<uint64_t>(ts.tv_sec) * 1'000'000'000ull + static_cast<uint64_t>(ts.tv_nsec);
+        }
+
+        // only the owning thread writes, the report may read concurrently
+        void add(PerfPhase p, const Sample& a, const Sample& b) {
+            Slot& t = totals_[static_cast<uint32_t>(p)];
+            bump(t.calls, 1);
+            bump(t.ns, b.ns - a.ns);
+            for (uint32_t e = 0; e < N_EVENTS; ++e) {
+                bump(t.ev[e], b.ev[e] - a.ev[e]);
+            }
+        }
+
+        void collect(Totals* out) const {
+            for (uint32_t p = 0; p < N_PHASES; ++p) {
+                out[p].calls += totals_[p].calls.load(std::memory_order_relaxed);
+                out[p].ns += totals_[p].ns.load(std::memory_order_relaxed);
+                for (uint32_t e = 0; e < N_EVENTS; ++e) {
+                    out[p].ev[e] += totals_[p].ev[e].load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        uint32_t open_mask() const noexcept { return mask_; }
+        int open_errno() const noexcept { return errno_; }
+
+    private:
+        struct Slot {
+            std::atomic<uint64_t> calls{0};
+            std::atomic<uint64_t> ns{0};
+            std::atomic<uint64_t> ev[N_EVENTS]{};
+        };
+
+        static void bump(std::atomic<uint64_t>& v, uint64_t d) {
+            v.store(v.load(std::memory_order_relaxed) + d, std::memory_order_relaxed);
+        }
+
+        static int perf_open(perf_event_attr& a, int group) {
+            return static_cast<int>(::syscall(SYS_perf_event_open, &a, 0, -1, group, PERF_FLAG_FD_CLOEXEC));
+        }
+
+        static void describe(uint32_t e, perf_event_attr& a) {
+            a.type = PERF_TYPE_HARDWARE;
+            switch (e) {
+                case CYCLES:
+                    a.config = PERF_COUNT_HW_CPU_CYCLES;
+                    break;
+                case INSTRUCTIONS:
+                    a.config = PERF_COUNT_HW_INSTRUCTIONS;
+                    break;
+                case DTLB_LOAD_MISSES:
+                    a.type = PERF_TYPE_HW_CACHE;
+                    a.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                    break;
+                case LLC_MISSES:
+                    a.config = PERF_COUNT_HW_CACHE_MISSES;
+                    break;
+                default:
+                    a.type = PERF_TYPE_SOFTWARE;
+                    a.config = PERF_COUNT_SW_PAGE_FAULTS;
+                    break;
+            }
+        }
+
+        // cycles lead the group, members that the cpu or the vm does not expose are left out.
+        // falls back to user space only counting when perf_event_paranoid forbids kernel counts
+        void open_group() {
+            for (int exclude_kernel = 0; exclude_kernel < 2 && n_open_ == 0; ++exclude_kernel) {
+                for (uint32_t e = 0; e < N_EVENTS; ++e) {
+                    perf_event_attr a{};
+                    a.size = sizeof(a);
+                    describe(e, a);
+                    a.read_format = PERF_FORMAT_GROUP;
+                    a.exclude_kernel = static_cast<uint64_t>(exclude_kernel);
+                    a.exclude_hv = 1;
+                    a.disabled = n_open_ == 0;
+                    const int fd = perf_open(a, n_open_ ? fds_[0] : -1);
+                    if (fd < 0) {
+                        errno_ = errno;
+                        if (n_open_ == 0 && e == CYCLES) {
+                            break;
+                        }
+                        continue;
+                    }
+                    fds_.push_back(fd);
+                    slot_[n_open_++] = e;
+                    mask_ |= 1u << e;
+                }
+            }
+            if (n_open_) {
+                ::ioctl(fds_[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+                ::ioctl(fds_[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+            }
+        }
+
+        std::vector<int> fds_;
+        uint32_t slot_[N_EVENTS]{};
+        uint32_t n_open_{0};
+        uint32_t mask_{0};
+        int errno_{0};
+        Slot totals_[N_PHASES];
+    };
+
+    static Thread& thread() {
+        thread_local Thread t;
+        return t;
+    }
+
+    // sums over live threads and threads that already exited
+    static void snapshot(Totals* out, uint32_t& mask, int& err) { registry().snapshot(out, mask, err); }
+
+    static void report(std::ostream& os) { print(registry(), os); }
+
+private:
+    class Registry;
+
+    static void print(Registry& r, std::ostream& os) {
+        Totals t[N_PHASES]{};
+        uint32_t mask = 0;
+        int err = 0;
+        r.snapshot(t, mask, err);
+
+        char line[256];
+        os << "[perf] per phase, inclusive, summed over threads\n";
+        if (mask == 0) {
+            os << "[perf] hardware counters unavailable (" << std::strerror(err)
+               << "), check kernel.perf_event_paranoid, timings only\n";
+        }
+        std::snprintf(line, sizeof(line), "%-22s %10s %12s", "phase", "calls", "ms");
+        os << line;
+        for (uint32_t e = 0; e < N_EVENTS; ++e) {
+            if (mask & (1u << e)) {
+                std::snprintf(line, sizeof(line), " %17s", event_name(e));
+                os << line;
+            }
+        }
+        if ((mask & (1u << CYCLES)) && (mask & (1u << INSTRUCTIONS))) {
+            os << "    ipc";
+        }
+        os << '\n';
+
+        for (uint32_t p = 0; p < N_PHASES; ++p) {
+            if (t[p].calls == 0) {
+                continue;
+            }
+            std::snprintf(line, sizeof(line), "%-22s %10llu %12.3f", phase_name(static_cast<PerfPhase>(p)),
+                          static_cast<unsigned long long>(t[p].calls), static_cast<double>(t[p].ns) * 1e-6);
+            os << line;
+            for (uint32_t e = 0; e < N_EVENTS; ++e) {
+                if (mask & (1u << e)) {
+                    std::snprintf(line, sizeof(line), " %17llu", static_cast<unsigned long long>(t[p].ev[e]));
+                    os << line;
+                }
+            }
+            if ((mask & (1u << CYCLES)) && (mask & (1u << INSTRUCTIONS)) && t[p].ev[CYCLES]) {
+                std::snprintf(line, sizeof(line), " %6.2f",
+                              static_cast<double>(t[p].ev[INSTRUCTIONS]) / static_cast<double>(t[p].ev[CYCLES]));
+                os << line;
+            }
+            os << '\n';
+        }
+        os.flush();
+    }
+
+    class Registry {
+    public:
+        // the run's report goes to stderr when the process exits, unless HFT_PERF_QUIET is set
+        ~Registry() {
+            if (!std::getenv("HFT_PERF_QUIET")) {
+                print(*this, std::cerr);
+            }
+        }
+
+        void attach(Thread* t) {
+            std::lock_guard<std::mutex> lk(mu_);
+            live_.push_back(t);
+        }
+
+        void detach(Thread* t) {
+            std::lock_guard<std::mutex> lk(mu_);
+            t->collect(retired_);
+            mask_ |= t->open_mask();
+            err_ = err_ ? err_ : t->open_errno();
+            live_.erase(std::remove(live_.begin(), live_.end(), t), live_.end());
+        }
+
+        void snapshot(Totals* out, uint32_t& mask, int& err) {
+            std::lock_guard<std::mutex> lk(mu_);
+            mask = mask_;
+            err = err_;
+            for (uint32_t p = 0; p < N_PHASES; ++p) {
+                out[p] = retired_[p];
+            }
+            for (const Thread* t : live_) {
+                t->collect(out);
+                mask |= t->open_mask();
+                err = err ? err : t->open_errno();
+            }
+        }
+
+    private:
+        std::mutex mu_;
+        std::vector<Thread*> live_;
+        Totals retired_[N_PHASES]{};
+        uint32_t mask_{0};
+        int err_{0};
+    };
+
+    static Registry& registry() {
+        static Registry r;
+        return r;
+    }
+};
+
+class PerfScope {
+public:
+    explicit PerfScope(PerfPhase p) : phase_(p), t_(PerfCounters::thread()) { t_.sample(start_); }
+
+    ~PerfScope() {
+        PerfCounters::Thread::Sample end;
+        t_.sample(end);
+        t_.add(phase_, start_, end);
+    }
+
+    PerfScope(const PerfScope&) = delete;
+    PerfScope& operator=(const PerfScope&) = delete;
+
+private:
+    PerfPhase phase_;
+    PerfCounters::Thread& t_;
+    PerfCounters::Thread::Sample start_;
+};
+
+#define HFT_PERF_CAT2(a, b) a##b
+#define HFT_PERF_CAT(a, b) HFT_PERF_CAT2(a, b)
+#define HFT_PERF_PHASE(phase) const PerfScope HFT_PERF_CAT(hft_perf_scope_, __LINE__)(PerfPhase::phase)
+#define HFT_PERF_REPORT(os) PerfCounters::report(os)
+
+#else
+
+#define HFT_PERF_PHASE(phase) static_cast<void>(0)
+#define HFT_PERF_REPORT(os) static_cast<void>(0)
+
+#endif
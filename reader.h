@@ -2,14 +2,18 @@
 #include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <cstdio>
 #include <cstring>
 #include <memory>
+#include <stdexcept>
 #include <string>
 #include <thread>
 #include <filesystem>
+#include <initializer_list>
 #include <vector>
 #include <algorithm>
 #include <charconv>
+#include <chrono>
 #include <type_traits>
 #include <fcntl.h>
 #include <sys/mman.h>
@@ -17,76 +21,73 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include "schemas.h"
+#include "catalog.h"
+#include "checksum.h"
+#include "huge_buff.h"
+#include "hot_cache.h"
+#include "perf_counters.h"
+#include "stage_copy.h"
+#include "uring.h"
 
-#ifndef MAP_HUGETLB
-#define MAP_HUGETLB 0x40000 // 2mb
-#endif
-
-#ifndef MAP_HUGE_SHIFT
-#define MAP_HUGE_SHIFT 26
-#endif
-
-#ifndef MAP_HUGE_2MB
-#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
-#endif
-
-struct HugeBuff {
-    void* ptr{nullptr};
-    size_t len{0};
-    bool huge_tlb{false};
-
-    static HugeBuff alloc(size_t bytes) {
-        HugeBuff buff;
-        const size_t two_mb = 2ull * 1024 * 1024;
-        // bytes rounded up to the next multiple of huge page size (2mb)
-        size_t want = (bytes + (two_mb - 1)) & ~(two_mb - 1);
-
-        int flags = MAP_PRIVATE|MAP_ANONYMOUS|MAP_POPULATE|MAP_HUGETLB| MAP_HUGE_2MB;
-        if (void* p = mmap(nullptr, want, PROT_READ|PROT_WRITE, flags, -1, 0); p != MAP_FAILED) {
-            buff.ptr = p;
-            buff.len = want;
-            buff.huge_tlb = true;
-            return buff;
-        }
-
-        if (void* p = ::mmap(nullptr, bytes, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
-            p != MAP_FAILED) {
-            ::madvise(p, bytes, MADV_HUGEPAGE);
-            buff.ptr=p;
-            buff.len=bytes;
-            }
-        return buff;
-    }
+namespace fs = std::filesystem;
 
-    void free() {
-        if (ptr) {
-            munmap(ptr, len);
-            ptr = nullptr;
-            len = 0;
-            huge_tlb = false;
-        }
-    }
+enum class ReadIo : uint8_t {
+    MMAP, // map the day and copy out of the page cache, faults one readahead window at a time
+    URING, // io_uring reads of the selected columns straight into the stage, deep queue, no page faults
 };
 
-
-
-namespace fs = std::filesystem;
-
 struct ReaderOpt {
     std::string base_dir;
     std::string product;
     uint32_t date_from = 0;
     uint32_t date_to = 99999999;
+    std::vector<uint32_t> only_days; // sorted, when non empty restricts the range to these days
+    bool use_catalog{true}; // plan days and rows from <product>/catalog.idx when it is complete, else list the dir
+    uint64_t cols{~0ull}; // bit c set = column c is advised, faulted in and staged, the others come back as nullptr
+    size_t stage_window_bytes{64ull << 20}; // stage size per reader in the windowed visits, over the selected columns
+    ReadIo io{ReadIo::MMAP}; // how whole days are staged, the windowed and mapped visits always map
+    uint32_t uring_depth{64}; // reads in flight
+    uint32_t uring_chunk_bytes{1u << 20}; // bytes per read, rounded to 4 KiB
+    bool uring_direct{false}; // O_DIRECT for the 4 KiB aligned part of columns that start 4 KiB aligned in the file
+    bool huge_map{true}; // MADV_HUGEPAGE on the selected columns of files written with WriterOpt::col_align >= 2 MB
+    uint32_t stage_threads{1}; // threads copying a day into the stage (StageCopier), caller included
+    size_t stage_stream_bytes{64ull << 20}; // a staging copy this big goes around the llc with non temporal stores
+    std::string hot_dir; // hugetlbfs or tmpfs mount for the hot day tier (HotDayCacheT), empty = off
+    uint64_t hot_budget_bytes{0}; // over all products in hot_dir, least recently used days are evicted past it
+    uint32_t hot_after_uses{2}; // a day is copied into the tier on its n-th staged read
+};
+
+// for ReaderT::for_each_row_batch
+struct RowBatchOpt {
+    static constexpr uint32_t AUTO = ~0u;
+
+    uint32_t batch_rows{0}; // 0 = what fits in 32 KiB of l1 over the columns present
+    uint32_t prefetch_rows{AUTO}; // how far ahead of the batch every column is prefetched, 0 = off,
+                                  // AUTO = tune_row_batch on the first segment big enough to time, the result is
+                                  // written back into the caller's opt so later segments reuse it
 };
 
+// ReaderOpt::cols for a subset, e.g. col_mask({L3Schema::COL_TS, L3Schema::COL_PX, L3Schema::COL_SZ})
+constexpr uint64_t col_mask(std::initializer_list<uint32_t> cols) {
+    uint64_t m = 0;
+    for (uint32_t c : cols) {
+        m |= 1ull << c;
+    }
+    return m;
+}
+
 template <class Schema>
 class ReaderT {
 public:
     using Header = ColFileHeaderT<Schema>;
 
+    static_assert(Schema::COLS <= 64, "[reader] column mask holds 64 columns");
+
     struct Segment {
         const void* col_ptrs[Schema::COLS];
         uint64_t rows{0};
+        uint64_t first_row{0}; // where row 0 sits in the day, non zero for all but the first window
+        uint64_t day_rows{0};
 
         template <class T>
         const T* col(uint32_t i) const noexcept {
@@ -94,31 +95,59 @@ public:
         }
     };
 
+    // slab leased from HugePool on the first day staged, columns laid out capacity_rows apart
     struct Stage {
-        HugeBuff slab{};
+        HugePool::Lease arena;
         std::byte* cols[Schema::COLS]{};
         size_t capacity_rows{0};
+        uint64_t mask{0}; // columns with room in the current layout
 
-        void ensure(size_t rows) {
-            size_t need = 0;
+        static constexpr size_t COL_ALIGN = 4096; // column starts, O_DIRECT reads land on them
+
+        // room for rows of the columns in mask, the others get no space and a nullptr
+        void ensure(size_t rows, uint64_t want = ~0ull) {
+            if (rows <= capacity_rows && want == mask) {
+                return;
+            }
+            size_t row_bytes = 0;
             for (uint32_t i = 0; i < Schema::COLS; ++i) {
-                need += rows * Schema::col_size(i);
+                if ((want >> i) & 1) {
+                    row_bytes += Schema::col_size(i);
+                }
+            }
+            if (row_bytes == 0) {
+                throw std::runtime_error("[reader] no columns selected");
             }
-            if (!slab.ptr || slab.len < need) {
-                if (slab.ptr) {
-                    slab.free();
+            if (!arena) {
+                arena = HugePool::acquire();
+            }
+            size_t need = 0;
+            for (uint32_t i = 0; i < Schema::COLS; ++i) {
+                if ((want >> i) & 1) {
+                    need += round_up(rows * Schema::col_size(i), COL_ALIGN);
                 }
-
-                slab = HugeBuff::alloc(need);
-                auto* p = static_cast<std::byte*>(slab.ptr);
-                // initialize ptr for each column
-                for (uint32_t i = 0; i < Schema::COLS; ++i) {
+            }
+            if (!arena->ensure(need)) {
+                throw std::runtime_error("[reader] could not commit stage memory");
+            }
+            // use everything the arena grew to, so slightly bigger days later on do not relayout
+            const size_t pad = Schema::COLS * COL_ALIGN;
+            capacity_rows = std::max(rows, arena->committed() > pad ? (arena->committed() - pad) / row_bytes : 0);
+            mask = want;
+            auto* p = arena->data();
+            // initialize ptr for each column
+            for (uint32_t i = 0; i < Schema::COLS; ++i) {
+                if ((want >> i) & 1) {
                     cols[i] = p;
-                    p += rows * Schema::col_size(i);
+                    p += round_up(capacity_rows * Schema::col_size(i), COL_ALIGN);
+                }
+                else {
+                    cols[i] = nullptr;
                 }
-                capacity_rows = rows;
             }
         }
+
+        HugeBacking backing() const noexcept { return arena ? arena->backing() : HugeBacking::NONE; }
     };
 
     Stage stage_;
@@ -135,11 +164,15 @@ public:
 
         Segment seg{};
         for (uint32_t c = 0; c < Schema::COLS; ++c) {
-            seg.col_ptrs[c] = col_ptrs_[c];
+            seg.col_ptrs[c] = wants(c) ? col_ptrs_[c] : nullptr;
         }
 
         seg.rows = rows_;
-        std::forward<Fn>(fn)(seg);
+        seg.day_rows = rows_;
+        {
+            HFT_PERF_PHASE(VISIT);
+            std::forward<Fn>(fn)(seg);
+        }
         unmap();
         return seg.rows;
     }
@@ -150,6 +183,9 @@ public:
             return false;
         }
         file_idx_ = 0;
+        if (use_uring()) {
+            return read_day(file_idx_, out);
+        }
         if (!map_file(files_[file_idx_].path)) {
             return false;
         }
@@ -157,6 +193,9 @@ public:
     }
 
     bool next_stage_file(Segment& out) {
+        if (use_uring()) {
+            return ++file_idx_ < files_.size() && read_day(file_idx_, out);
+        }
         if (!advance()) {
             return false;
         }
@@ -171,7 +210,12 @@ public:
             return;
         }
         do {
-            if (!fn(s)) {
+            bool more;
+            {
+                HFT_PERF_PHASE(VISIT);
+                more = fn(s);
+            }
+            if (!more) {
                 break;
             }
         }
@@ -179,39 +223,440 @@ public:
     }
 
 
-    explicit ReaderT(const ReaderOpt& opt) : opt_(opt) { build_day_file_list(); }
+    // stages day k of days() on its own, used by schedulers that hand days out of order
+    bool stage_day(size_t k, Segment& out) {
+        if (k >= files_.size()) {
+            return false;
+        }
+        file_idx_ = k;
+        if (use_uring()) {
+            return read_day(k, out);
+        }
+        if (!map_file(files_[k].path)) {
+            return false;
+        }
+        const bool ok = stage_curr_file(out);
+        // a hot day is handed out in place, its mapping lives until the next day
+        if (!hot_mapped_) {
+            unmap();
+        }
+        return ok;
+    }
+
+    // walks a segment (typically a mapped one, straight off the page cache) in l1 sized batches, fn(const Segment&)
+    // gets the batch as a sub segment (first_row relative to the day). every present column is prefetched
+    // prefetch_rows ahead, so the stream prefetchers and the page walks run ahead of fn without staging a copy.
+    // with prefetch_rows AUTO the tuned distance is stored back into opt, pass the same opt for every segment of a
+    // run. a segment too small to time runs with prefetch off and leaves opt AUTO so a bigger one tunes it
+    template <class Fn>
+    static void for_each_row_batch(const Segment& seg, RowBatchOpt& opt, Fn&& fn) {
+        const uint64_t batch = batch_size(seg, opt.batch_rows);
+        uint32_t ahead = opt.prefetch_rows;
+        if (ahead == RowBatchOpt::AUTO) {
+            ahead = tune_row_batch(seg, opt.batch_rows).prefetch_rows;
+            if (ahead != RowBatchOpt::AUTO) {
+                opt.prefetch_rows = ahead;
+            }
+            else {
+                ahead = 0;
+            }
+        }
+        for (uint64_t r0 = 0; r0 < seg.rows; r0 += batch) {
+            const uint64_t n = std::min(batch, seg.rows - r0);
+            if (ahead) {
+                prefetch_ahead(seg, r0 + ahead, n);
+            }
+            Segment b{};
+            for (uint32_t c = 0; c < Schema::COLS; ++c) {
+                b.col_ptrs[c] = seg.col_ptrs[c]
+                    ? static_cast<const std::byte*>(seg.col_ptrs[c]) + r0 * Schema::col_size(c)
+                    : nullptr;
+            }
+            b.rows = n;
+            b.first_row = seg.first_row + r0;
+            b.day_rows = seg.day_rows;
+            fn(b);
+        }
+    }
+
+    // a temporary opt has nowhere to keep the tuned distance, AUTO then tunes on every call
+    template <class Fn>
+    static void for_each_row_batch(const Segment& seg, RowBatchOpt&& opt, Fn&& fn) {
+        for_each_row_batch(seg, opt, std::forward<Fn>(fn));
+    }
+
+    // times a plain pass over every present column at a few prefetch distances, each on its own slice of seg so no
+    // candidate runs on lines an earlier one pulled in, and returns the fastest (0 = off, also what a segment already
+    // in cache measures). segments too small to tell come back with prefetch_rows AUTO, nothing was measured
+    static RowBatchOpt tune_row_batch(const Segment& seg, uint32_t batch = 0) {
+        RowBatchOpt best{static_cast<uint32_t>(batch_size(seg, batch)), RowBatchOpt::AUTO};
+        static constexpr uint32_t batches_ahead[] = {0, 1, 2, 4, 8, 16};
+        static constexpr uint32_t N = sizeof(batches_ahead) / sizeof(batches_ahead[0]);
+        const uint64_t slice = std::max<uint64_t>(best.batch_rows * 64ull, seg.rows / (2 * N)) / best.batch_rows *
+            best.batch_rows;
+        if (slice * 2 * N > seg.rows) {
+            return best;
+        }
+        double ns[N];
+        for (uint32_t i = 0; i < N; ++i) {
+            ns[i] = 1e300;
+        }
+        // two rounds, the second in reverse order, min per candidate
+        for (uint32_t round = 0; round < 2; ++round) {
+            for (uint32_t j = 0; j < N; ++j) {
+                const uint32_t i = round ? N - 1 - j : j;
+                Segment s = seg;
+                const uint64_t r0 = (round * N + j) * slice;
+                for (uint32_t c = 0; c < Schema::COLS; ++c) {
+                    s.col_ptrs[c] = seg.col_ptrs[c]
+                        ? static_cast<const std::byte*>(seg.col_ptrs[c]) + r0 * Schema::col_size(c)
+                        : nullptr;
+                }
+                s.rows = slice;
+                uint64_t sink = 0;
+                const auto t0 = std::chrono::steady_clock::now();
+                for_each_row_batch(s, RowBatchOpt{best.batch_rows, batches_ahead[i] * best.batch_rows},
+                                   [&](const Segment& b) { sink += touch_batch(b); });
+                const auto t1 = std::chrono::steady_clock::now();
+                asm volatile("" : : "r"(sink) : "memory");
+                ns[i] = std::min(ns[i], std::chrono::duration<double, std::nano>(t1 - t0).count());
+            }
+        }
+        uint32_t pick = 0;
+        for (uint32_t i = 1; i < N; ++i) {
+            // a distance has to beat no prefetch by a few percent to be worth the extra instructions
+            if (ns[i] < ns[pick] * (pick == 0 ? 0.97 : 1.0)) {
+                pick = i;
+            }
+        }
+        best.prefetch_rows = batches_ahead[pick] * best.batch_rows;
+        return best;
+    }
+
+    // stages every day a window of rows at a time into a stage of stage_window_bytes, memory stays bounded however
+    // big the day is. fn(const Segment&) returns false to stop
+    template <class Fn>
+    void visit_stage_windows(Fn&& fn) {
+        for (size_t k = 0; k < files_.size(); ++k) {
+            if (!stage_day_windows(k, fn)) {
+                break;
+            }
+        }
+    }
+
+    // windows of day k of days() in row order, the pages of the next window are advised before fn sees the current
+    // one so the kernel reads ahead while fn runs. false once fn asked to stop
+    template <class Fn>
+    bool stage_day_windows(size_t k, Fn&& fn) {
+        if (k >= files_.size()) {
+            return true;
+        }
+        file_idx_ = k;
+        if (!map_file(files_[k].path, false)) {
+            return true;
+        }
+        const uint64_t win = window_rows();
+        bool more = true;
+        advise_rows(0, std::min(win, rows_));
+        for (uint64_t r0 = 0; more && r0 < rows_; r0 += win) {
+            const uint64_t n = std::min(win, rows_ - r0);
+            if (r0 + n < rows_) {
+                advise_rows(r0 + n, std::min(win, rows_ - r0 - n));
+            }
+            Segment seg{};
+            stage_rows(r0, n, seg);
+            HFT_PERF_PHASE(VISIT);
+            more = fn(seg);
+        }
+        if (more) {
+            note_use(col_ptrs_);
+        }
+        unmap();
+        return more;
+    }
+
+    explicit ReaderT(const ReaderOpt& opt) : opt_(opt), copier_(opt.stage_threads, opt.stage_stream_bytes) {
+        build_day_file_list();
+        if (!opt_.hot_dir.empty() && opt_.hot_budget_bytes) {
+            hot_ = std::make_unique<HotDayCacheT<Schema>>(opt_.hot_dir, opt_.product, opt_.hot_budget_bytes,
+                                                          opt_.hot_after_uses);
+        }
+    }
     ~ReaderT() { unmap(); }
 
     inline const std::vector<uint32_t>& days() const noexcept { return days_; }
     inline const std::vector<fs::path>& paths() const noexcept { return paths_only_; }
+    // row count per day, known before any data file is opened when planned from the catalog. 0 for days still
+    // being written and for every day when the directory was scanned
+    inline const std::vector<uint64_t>& day_rows() const noexcept { return rows_only_; }
+    inline bool from_catalog() const noexcept { return from_catalog_; }
+    // bytes staged and GB/s, StageCopier::report prints them
+    inline const StageCopier& stage_copier() const noexcept { return copier_; }
+    // null unless ReaderOpt::hot_dir is set, for hits / promotions / evictions
+    inline const HotDayCacheT<Schema>* hot_cache() const noexcept { return hot_.get(); }
+
+    // rebuilds the catalog from the day files on disk and marks it complete, for directories written before the
+    // catalog existed or changed by hand. entries the writers recorded are kept, a file that does not read back is
+    // listed with unknown rows
+    static bool rebuild_catalog(const ReaderOpt& opt) {
+        const fs::path root = opt.product.empty() ? fs::path(opt.base_dir) : fs::path(opt.base_dir) / opt.product;
+        if (!fs::exists(root)) {
+            return false;
+        }
+        std::vector<CatalogEntry> entries;
+        for (const auto& e : fs::directory_iterator(root)) {
+            uint32_t d = 0;
+            if (!e.is_regular_file() || !parse_yyyymmdd(e.path().filename().string(), d)) {
+                continue;
+            }
+            CatalogEntry ce{};
+            if (!read_catalog_entry(e.path(), d, ce)) {
+                ce = DayCatalog::make_entry(d, e.path().filename().string(), CatalogCodec::COLUMNS, 0, 0, 0, 0, 0, 0,
+                                            0, CATALOG_DAY_OPEN);
+            }
+            entries.push_back(ce);
+        }
+        return DayCatalog::backfill(root, std::move(entries));
+    }
 
 private:
     struct DayFile {
         uint32_t yyyymmdd;
         fs::path path;
+        uint64_t rows;
     };
 
     bool stage_curr_file(Segment& out) {
+        HFT_PERF_PHASE(STAGING);
         if (!mapped_ || rows_ == 0) {
             return false;
         }
 
-        stage_.ensure(static_cast<size_t>(rows_));
+        if (!hot_mapped_) {
+            stage_.ensure(static_cast<size_t>(rows_), opt_.cols);
+        }
+        copy_rows(0, rows_, out);
+        note_use(col_ptrs_);
+        return true;
+    }
+
+    // counts a staged read of the current day towards promotion into the hot tier, cols are its full columns
+    void note_use(const std::byte* const* cols) {
+        if (hot_ && !hot_mapped_) {
+            const void* c[Schema::COLS];
+            for (uint32_t i = 0; i < Schema::COLS; ++i) {
+                c[i] = cols[i];
+            }
+            hot_->note_use(files_[file_idx_].path, hdr_, c);
+        }
+    }
+
+    // the ring is set up on first use, kernels or sandboxes without io_uring fall back to mapping (logged once)
+    bool use_uring() {
+        if (opt_.io != ReadIo::URING || uring_off_) {
+            return false;
+        }
+        if (!ring_) {
+            ring_ = std::make_unique<Uring>(std::max(1u, opt_.uring_depth));
+            if (!ring_->ok()) {
+                static std::atomic<bool> warned{false};
+                if (!warned.exchange(true, std::memory_order_relaxed)) {
+                    std::fprintf(stderr, "[reader] io_uring unavailable (%s), staging through mmap\n",
+                                 std::strerror(ring_->error()));
+                }
+                ring_.reset();
+                uring_off_ = true;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // ReadIo::URING: header by pread, then every selected column read into its stage slot with the ring kept full
+    bool read_day(size_t k, Segment& out) {
+        HFT_PERF_PHASE(STAGING);
+        unmap();
+        const fs::path& p = files_[k].path;
+        if (const fs::path hot = hot_ ? hot_->find(p) : fs::path{}; !hot.empty()) {
+            return map_path(hot, true, true) && stage_curr_file(out);
+        }
+        const int fd = ::open(p.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st{};
+        Header hdr{};
+        bool ok = ::fstat(fd, &st) == 0 && ::pread(fd, &hdr, sizeof(hdr), 0) == static_cast<ssize_t>(sizeof(hdr)) &&
+            std::memcmp(hdr.magic, Schema::MAGIC, sizeof(hdr.magic)) == 0 && hdr.rows > 0;
+        bool aligned = opt_.uring_direct;
+        for (uint32_t c = 0; ok && c < Schema::COLS; ++c) {
+            if (wants(c)) {
+                ok = hdr.col_off[c] + hdr.rows * Schema::col_size(c) <= static_cast<uint64_t>(st.st_size);
+                aligned = aligned && hdr.col_off[c] % Stage::COL_ALIGN == 0;
+            }
+        }
+        if (!ok) {
+            ::close(fd);
+            return false;
+        }
+        const int dfd = aligned ? ::open(p.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT) : -1;
+
+        stage_.ensure(static_cast<size_t>(hdr.rows), opt_.cols);
+        std::vector<UringBulkRead::Range> ranges;
         for (uint32_t c = 0; c < Schema::COLS; ++c) {
-            const size_t sz = static_cast<size_t>(Schema::col_size(c));
-            const size_t bytes = rows_ * sz;
-            // copy column to stage
-            std::memcpy(stage_.cols[c], col_ptrs_[c], bytes);
+            if (!wants(c)) {
+                out.col_ptrs[c] = nullptr;
+                continue;
+            }
+            const uint64_t len = hdr.rows * Schema::col_size(c);
+            // direct reads need block aligned offset, length and buffer, the tail goes through the page cache
+            const uint64_t body = dfd >= 0 ? len & ~uint64_t{Stage::COL_ALIGN - 1} : 0;
+            if (body) {
+                ranges.push_back({dfd, hdr.col_off[c], body, stage_.cols[c]});
+            }
+            if (len > body) {
+                ranges.push_back({fd, hdr.col_off[c] + body, len - body, stage_.cols[c] + body});
+            }
             out.col_ptrs[c] = stage_.cols[c];
         }
-        out.rows = rows_;
+        const uint32_t chunk = std::max<uint32_t>(Stage::COL_ALIGN, opt_.uring_chunk_bytes & ~(Stage::COL_ALIGN - 1));
+        int err = 0;
+        ok = UringBulkRead::run(*ring_, ranges, chunk, err);
+        if (dfd >= 0) {
+            ::close(dfd);
+        }
+        ::close(fd);
+        if (!ok) {
+            std::fprintf(stderr, "[reader] io_uring read of %s failed (%s)\n", p.c_str(), std::strerror(err));
+            if (ring_->pending()) {
+                // reads we could not wait out, closing the ring cancels them. later days stage through mmap
+                std::fprintf(stderr, "[reader] io_uring left with %u pending, staging through mmap\n",
+                             ring_->pending());
+                ring_.reset();
+                uring_off_ = true;
+            }
+            return false;
+        }
+        hdr_ = hdr;
+        out.rows = hdr.rows;
+        out.first_row = 0;
+        out.day_rows = hdr.rows;
+        if (hot_) {
+            const std::byte* cols[Schema::COLS];
+            for (uint32_t c = 0; c < Schema::COLS; ++c) {
+                cols[c] = wants(c) ? stage_.cols[c] : nullptr;
+            }
+            note_use(cols);
+        }
         return true;
     }
 
+    // one window of the mapped day into the stage
+    void stage_rows(uint64_t first, uint64_t n, Segment& out) {
+        HFT_PERF_PHASE(STAGING);
+        if (!hot_mapped_) {
+            stage_.ensure(static_cast<size_t>(n), opt_.cols);
+        }
+        copy_rows(first, n, out);
+    }
+
+    void copy_rows(uint64_t first, uint64_t n, Segment& out) {
+        StageCopier::Job jobs[Schema::COLS];
+        size_t n_jobs = 0;
+        for (uint32_t c = 0; c < Schema::COLS; ++c) {
+            if (!wants(c)) {
+                out.col_ptrs[c] = nullptr;
+                continue;
+            }
+            const size_t sz = static_cast<size_t>(Schema::col_size(c));
+            if (hot_mapped_) {
+                // already in memory with 2 MB pages, nothing to stage
+                out.col_ptrs[c] = col_ptrs_[c] + first * sz;
+                continue;
+            }
+            jobs[n_jobs++] = {stage_.cols[c], col_ptrs_[c] + first * sz, n * sz};
+            out.col_ptrs[c] = stage_.cols[c];
+        }
+        if (n_jobs) {
+            copier_.run(jobs, n_jobs);
+        }
+        out.rows = n;
+        out.first_row = first;
+        out.day_rows = rows_;
+    }
+
+    static uint64_t batch_size(const Segment& seg, uint32_t want) {
+        if (want) {
+            return want;
+        }
+        size_t row_bytes = 0;
+        for (uint32_t c = 0; c < Schema::COLS; ++c) {
+            if (seg.col_ptrs[c]) {
+                row_bytes += Schema::col_size(c);
+            }
+        }
+        const uint64_t rows = row_bytes ? (32u << 10) / row_bytes : 1024;
+        return std::max<uint64_t>(64, rows & ~uint64_t{63});
+    }
+
+    // rows [first, first + n) of every present column, clipped to the segment, one prefetch per cache line
+    static void prefetch_ahead(const Segment& seg, uint64_t first, uint64_t n) {
+        if (first >= seg.rows) {
+            return;
+        }
+        n = std::min(n, seg.rows - first);
+        for (uint32_t c = 0; c < Schema::COLS; ++c) {
+            if (!seg.col_ptrs[c]) {
+                continue;
+            }
+            const size_t sz = Schema::col_size(c);
+            const auto* p = static_cast<const char*>(seg.col_ptrs[c]) + first * sz;
+            const auto* end = p + n * sz;
+            for (p = reinterpret_cast<const char*>(reinterpret_cast<uintptr_t>(p) & ~uintptr_t{63}); p < end; p += 64) {
+                __builtin_prefetch(p, 0, 3);
+            }
+        }
+    }
+
+    // reads every byte of the batch, the tuning workload
+    static uint64_t touch_batch(const Segment& b) {
+        uint64_t acc = 0;
+        for (uint32_t c = 0; c < Schema::COLS; ++c) {
+            if (!b.col_ptrs[c]) {
+                continue;
+            }
+            const auto* p = static_cast<const uint8_t*>(b.col_ptrs[c]);
+            const size_t bytes = b.rows * Schema::col_size(c);
+            size_t i = 0;
+            for (; i + 8 <= bytes; i += 8) {
+                uint64_t v;
+                std::memcpy(&v, p + i, 8);
+                acc += v;
+            }
+            for (; i < bytes; ++i) {
+                acc += p[i];
+            }
+        }
+        return acc;
+    }
+
+    // rows per window, a multiple of 64 so every column of the stage starts on a cache line
+    uint64_t window_rows() const noexcept {
+        size_t row_bytes = 0;
+        for (uint32_t c = 0; c < Schema::COLS; ++c) {
+            if (wants(c)) {
+                row_bytes += Schema::col_size(c);
+            }
+        }
+        const uint64_t rows = row_bytes ? opt_.stage_window_bytes / row_bytes : 0;
+        return std::max<uint64_t>(64, rows & ~uint64_t{63});
+    }
+
     void fill_segment(Segment& out) {
         for (uint32_t c = 0; c < Schema::COLS; ++c) {
-            out.col_ptrs[c] = col_ptrs_[c];
+            out.col_ptrs[c] = wants(c) ? col_ptrs_[c] : nullptr;
             out.rows = rows_;
+            out.day_rows = rows_;
         }
     }
 
@@ -242,15 +687,103 @@ private:
         return true;
     }
 
+    // maps the file once to read the header, the ts range and the content crc the writer would have recorded
+    static bool read_catalog_entry(const fs::path& p, uint32_t d, CatalogEntry& out) {
+        const int fd = ::open(p.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st{};
+        if (::fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(Header))) {
+            ::close(fd);
+            return false;
+        }
+        const size_t bytes = static_cast<size_t>(st.st_size);
+        void* m = ::mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (m == MAP_FAILED) {
+            return false;
+        }
+        ::madvise(m, bytes, MADV_SEQUENTIAL);
+        const auto* base = static_cast<const uint8_t*>(m);
+
+        Header hdr{};
+        std::memcpy(&hdr, base, sizeof(hdr));
+        bool ok = std::memcmp(hdr.magic, Schema::MAGIC, sizeof(hdr.magic)) == 0;
+        for (uint32_t c = 0; ok && c < Schema::COLS; ++c) {
+            ok = hdr.col_off[c] + hdr.rows * Schema::col_size(c) <= bytes;
+        }
+        if (ok) {
+            uint32_t crc = 0;
+            for (uint32_t c = 0; c < Schema::COLS; ++c) {
+                crc = Crc32c::compute(base + hdr.col_off[c], hdr.rows * Schema::col_size(c), crc);
+            }
+            uint64_t first = 0;
+            uint64_t last = 0;
+            if (hdr.rows) {
+                const uint8_t* ts = base + hdr.col_off[Schema::COL_TS];
+                std::memcpy(&first, ts, sizeof(first));
+                std::memcpy(&last, ts + (hdr.rows - 1) * sizeof(last), sizeof(last));
+            }
+            out = DayCatalog::make_entry(d, p.filename().string(), CatalogCodec::COLUMNS, 0, hdr.version, hdr.rows,
+                                         static_cast<uint64_t>(bytes), first, last, crc);
+        }
+        ::munmap(m, bytes);
+        return ok;
+    }
+
+    bool in_range(uint32_t d) const {
+        if (d < opt_.date_from || d > opt_.date_to) {
+            return false;
+        }
+        return opt_.only_days.empty() || std::binary_search(opt_.only_days.begin(), opt_.only_days.end(), d);
+    }
+
+    // days and rows from a complete catalog without touching the directory. false when there is none or an entry
+    // does not read back as a column day file, the caller scans then
+    bool load_catalog(const fs::path& root) {
+        DayCatalog cat(root);
+        if (!cat.complete()) {
+            return false;
+        }
+        std::vector<DayFile> files;
+        for (const CatalogEntry& e : cat) {
+            const std::string name = DayCatalog::file_name(e);
+            uint32_t d = 0;
+            if (e.codec != static_cast<uint8_t>(CatalogCodec::COLUMNS) || !parse_yyyymmdd(name, d) || d != e.yyyymmdd) {
+                return false;
+            }
+            if (!in_range(d)) {
+                continue;
+            }
+            const bool final_rows = !(e.flags & CATALOG_DAY_OPEN) && e.schema_version == Schema::VERSION;
+            files.push_back(DayFile{d, root / name, final_rows ? e.rows : 0});
+        }
+        files_.swap(files);
+        return true;
+    }
+
     void build_day_file_list() {
         files_.clear();
         days_.clear();
         paths_only_.clear();
+        rows_only_.clear();
         const fs::path root = product_dir();
+        from_catalog_ = opt_.use_catalog && load_catalog(root);
+        if (!from_catalog_) {
+            scan_day_files(root);
+        }
+        for (auto& f : files_) {
+            days_.push_back(f.yyyymmdd);
+            paths_only_.push_back(f.path);
+            rows_only_.push_back(f.rows);
+        }
+    }
+
+    void scan_day_files(const fs::path& root) {
         if (!fs::exists(root)) {
             return;
         }
-
         for (const auto& e : fs::directory_iterator(root)) {
             if (!e.is_regular_file()) {
                 continue;
@@ -260,20 +793,24 @@ private:
             if (!parse_yyyymmdd(name, d)) {
                 continue;
             }
-            if (d < opt_.date_from || d > opt_.date_to) {
+            if (!in_range(d)) {
                 continue;
             }
-            files_.push_back(DayFile{d, e.path()});
+            files_.push_back(DayFile{d, e.path(), 0});
         }
         std::sort(files_.begin(), files_.end(),
                   [](const DayFile& a, const DayFile& b) { return a.yyyymmdd < b.yyyymmdd; });
-        for (auto& f : files_) {
-            days_.push_back(f.yyyymmdd);
-            paths_only_.push_back(f.path);
-        }
     }
 
-    bool map_file(const fs::path& p) {
+    // advise = false leaves read ahead to the caller, the windowed visits advise one window at a time. maps the hot
+    // tier's copy instead when it has a current one, same format with the columns already 2 MB aligned
+    bool map_file(const fs::path& p, bool advise = true) {
+        const fs::path hot = hot_ ? hot_->find(p) : fs::path{};
+        return hot.empty() ? map_path(p, advise, false) : map_path(hot, advise, true);
+    }
+
+    bool map_path(const fs::path& p, bool advise, bool hot) {
+        HFT_PERF_PHASE(MAPPING);
         unmap();
 
         fd_ = ::open(p.c_str(), O_RDONLY | O_CLOEXEC);
@@ -289,7 +826,8 @@ private:
         }
         map_bytes_ = static_cast<size_t>(st.st_size);
 
-        map_ = ::mmap(nullptr, map_bytes_, PROT_READ, MAP_SHARED, fd_, 0);
+        // 2 MB aligned so the 2 MB aligned columns of aligned layout files can be mapped with huge pages
+        map_ = map_file_aligned(fd_, map_bytes_, HUGE_2MB);
         if (map_ == MAP_FAILED) {
             map_ = nullptr;
             ::close(fd_);
@@ -297,9 +835,12 @@ private:
             return false;
         }
 
-        posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
-        madvise(map_, map_bytes_, MADV_SEQUENTIAL);
-        madvise(map_, map_bytes_, MADV_WILLNEED);
+        const bool all_cols = (opt_.cols & all_mask()) == all_mask();
+        if (advise && all_cols) {
+            posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+            madvise(map_, map_bytes_, MADV_SEQUENTIAL);
+            madvise(map_, map_bytes_, MADV_WILLNEED);
+        }
 
         const auto* base = static_cast<const std::byte*>(map_);
         std::memcpy(&hdr_, base, sizeof(Header));
@@ -317,11 +858,58 @@ private:
             // size of element each col hols
             col_sz_[c] = hdr_.col_sz[c];
         }
+        if (advise && !all_cols) {
+            advise_rows(0, rows_);
+        }
+        if (opt_.huge_map && hdr_.layout == COL_LAYOUT_ALIGNED && hdr_.col_align >= HUGE_2MB) {
+            advise_huge();
+        }
         idx_ = 0;
+        hot_mapped_ = hot;
         mapped_ = true;
         return true;
     }
 
+    // read ahead rows [first, first + n) of the selected columns only, the pages of the others are never touched
+    void advise_rows(uint64_t first, uint64_t n) {
+        const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        auto* base = static_cast<std::byte*>(map_);
+        for (uint32_t c = 0; c < Schema::COLS; ++c) {
+            if (!wants(c)) {
+                continue;
+            }
+            const size_t sz = Schema::col_size(c);
+            const size_t from = static_cast<size_t>(hdr_.col_off[c] + first * sz) & ~(page - 1);
+            const size_t to = std::min<size_t>(hdr_.col_off[c] + (first + n) * sz, map_bytes_);
+            if (to > from) {
+                madvise(base + from, to - from, MADV_SEQUENTIAL);
+                madvise(base + from, to - from, MADV_WILLNEED);
+            }
+        }
+    }
+
+    // whole 2 MB pages of the selected columns, the page cache may hand them out as pmd mappings (tmpfs with
+    // huge=advise, file systems with large folios) where 4 KiB ptes would otherwise cost a dtlb entry each
+    void advise_huge() {
+        auto* base = static_cast<std::byte*>(map_);
+        for (uint32_t c = 0; c < Schema::COLS; ++c) {
+            if (!wants(c) || hdr_.col_off[c] >= map_bytes_) {
+                continue;
+            }
+            const size_t to = std::min<size_t>(round_up(hdr_.col_off[c] + rows_ * Schema::col_size(c), HUGE_2MB),
+                                               map_bytes_);
+            if (to > hdr_.col_off[c]) {
+                madvise(base + hdr_.col_off[c], to - hdr_.col_off[c], MADV_HUGEPAGE);
+            }
+        }
+    }
+
+    static constexpr uint64_t all_mask() noexcept {
+        return Schema::COLS == 64 ? ~0ull : (1ull << Schema::COLS) - 1;
+    }
+
+    bool wants(uint32_t c) const noexcept { return (opt_.cols >> c) & 1; }
+
     bool advance() {
         if (!mapped_) {
             return false;
@@ -346,13 +934,21 @@ private:
         rows_ = 0;
         idx_ = 0;
         mapped_ = false;
+        hot_mapped_ = false;
     }
 
 private:
     ReaderOpt opt_;
+    StageCopier copier_;
+    std::unique_ptr<Uring> ring_;
+    bool uring_off_{false};
+    std::unique_ptr<HotDayCacheT<Schema>> hot_;
+    bool hot_mapped_{false}; // the current day is mapped from the hot tier
     std::vector<DayFile> files_;
     std::vector<uint32_t> days_;
     std::vector<fs::path> paths_only_;
+    std::vector<uint64_t> rows_only_;
+    bool from_catalog_{false};
     size_t file_idx_{0};
     int fd_{-1};
     void* map_{nullptr};
@@ -369,4 +965,5 @@ using L2Reader = ReaderT<L2Schema>;
 using L3Reader = ReaderT<L3Schema>;
 using ImbalanceReader = ReaderT<ImbalanceSchema>;
 using VwapReader = ReaderT<VwapSchema>;
-using VoiReader = ReaderT<VoiSchema>;
\ No newline at end of file
+using VoiReader = ReaderT<VoiSchema>;
+using BarReader = ReaderT<BarSchema>;
\ No newline at end of file
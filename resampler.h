@@ -0,0 +1,276 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include "factors.h"
+#include "reader.h"
+#include "writer.h"
+
+// turns one l2 day into bars at several time resolutions (and optionally tick bars) in a single scan.
+// the scan only builds buckets of the finest interval, coarser ones are folded from those, so every interval
+// must be a multiple of the smallest. qty by side comes from the simd prefix sums in Factors.
+// mid = (last bid px + last ask px) / 2, exact when the feed carries top of book updates, weighted by the time
+// it was in force inside the bar (gaps between events included), bars without events are not emitted
+class Resampler {
+public:
+    using Segment = ReaderT<L2Schema>::Segment;
+
+    explicit Resampler(std::vector<uint64_t> intervals_ns, uint32_t tick_rows = 0) : tick_rows_(tick_rows) {
+        if (intervals_ns.empty() && tick_rows == 0) {
+            throw std::runtime_error("[resampler] nothing to resample to");
+        }
+        std::sort(intervals_ns.begin(), intervals_ns.end());
+        for (uint64_t iv : intervals_ns) {
+            if (iv == 0 || iv % intervals_ns[0] != 0) {
+                throw std::runtime_error("[resampler] intervals must be multiples of the smallest one");
+            }
+            levels_.push_back(Level{iv, {}, {}});
+        }
+    }
+
+    size_t levels() const noexcept { return levels_.size(); }
+    uint64_t interval(size_t k) const noexcept { return levels_[k].interval; }
+    uint32_t tick_rows() const noexcept { return tick_rows_; }
+
+    // bars of the last day, per interval (in the constructor's sorted order) and tick bars
+    const std::vector<BarRow>& bars(size_t k) const noexcept { return levels_[k].out; }
+    const std::vector<BarRow>& tick_bars() const noexcept { return tick_out_; }
+
+    // one day, state (last bid/ask) does not carry over to the next call
+    void resample(const Segment& seg) {
+        const size_t n = seg.rows;
+        const auto* ts = seg.col<uint64_t>(L2Schema::COL_TS);
+        const auto* px = seg.col<uint32_t>(L2Schema::COL_PX);
+        const auto* qty = seg.col<float>(L2Schema::COL_QTY);
+        const auto* side = seg.col<uint8_t>(L2Schema::COL_SIDE);
+
+        for (Level& l : levels_) {
+            l.out.clear();
+            l.acc = Acc{};
+        }
+        tick_out_.clear();
+        if (n == 0) {
+            return;
+        }
+
+        // prefix sums of qty and signed qty, bid = (q + s) / 2, ask = (q - s) / 2 over any row range
+        signed_.resize(n);
+        pq_.resize(n + 1);
+        ps_.resize(n + 1);
+        Factors::signed_qty(side, qty, n, signed_.data());
+        Factors::prefix_sum(qty, n, pq_.data());
+        Factors::prefix_sum(signed_.data(), n, ps_.data());
+
+        if (!levels_.empty()) {
+            time_pass(ts, px, side, n);
+        }
+        if (tick_rows_) {
+            tick_pass(ts, px, side, n);
+        }
+    }
+
+private:
+    struct Acc {
+        uint64_t start{0};
+        uint64_t end{0}; // ts of the last event folded in
+        uint32_t last_px{0};
+        uint32_t n{0};
+        double bid_qty{0};
+        double ask_qty{0};
+        double area{0}; // integral of mid over time
+        uint64_t covered{0}; // ns with a known mid
+    };
+
+    struct Level {
+        uint64_t interval;
+        Acc acc;
+        std::vector<BarRow> out;
+    };
+
+    // rows [i, j) starting at bucket start s, mid integrated from s to ts[j - 1], advances the bid/ask state
+    Acc bucket(const uint64_t* ts, const uint32_t* px, const uint8_t* side, size_t i, size_t j, uint64_t s) {
+        Acc a{};
+        a.start = s;
+        a.end = ts[j - 1];
+        a.last_px = px[j - 1];
+        a.n = static_cast<uint32_t>(j - i);
+        const double dq = pq_[j] - pq_[i];
+        const double ds = ps_[j] - ps_[i];
+        a.bid_qty = 0.5 * (dq + ds);
+        a.ask_qty = 0.5 * (dq - ds);
+
+        uint64_t t = s;
+        for (size_t k = i; k < j; ++k) {
+            if (bid_ && ask_) {
+                a.area += mid() * static_cast<double>(ts[k] - t);
+                a.covered += ts[k] - t;
+            }
+            t = ts[k];
+            (side[k] ? bid_ : ask_) = px[k];
+        }
+        return a;
+    }
+
+    double mid() const noexcept { return 0.5 * (static_cast<double>(bid_) + static_cast<double>(ask_)); }
+
+    // the mid in force before the bucket being folded, covers the empty stretch [from, to)
+    void add_gap(Acc& a, uint64_t from, uint64_t to, bool valid, double m) {
+        if (valid && to > from) {
+            a.area += m * static_cast<double>(to - from);
+            a.covered += to - from;
+        }
+    }
+
+    static BarRow to_row(const Acc& a) {
+        return BarRow{a.start, a.last_px, a.n, static_cast<float>(a.bid_qty), static_cast<float>(a.ask_qty),
+                      a.covered ? static_cast<float>(a.area / static_cast<double>(a.covered)) : 0.0f};
+    }
+
+    void fold(Level& l, const Acc& f, bool prev_valid, double prev_mid) {
+        Acc& a = l.acc;
+        const uint64_t cs = f.start / l.interval * l.interval;
+        if (a.n && a.start != cs) {
+            add_gap(a, a.end, a.start + l.interval, prev_valid, prev_mid);
+            l.out.push_back(to_row(a));
+            a.n = 0;
+        }
+        if (a.n == 0) {
+            a = Acc{};
+            a.start = cs;
+            add_gap(a, cs, f.start, prev_valid, prev_mid);
+        }
+        else {
+            add_gap(a, a.end, f.start, prev_valid, prev_mid);
+        }
+        a.end = f.end;
+        a.last_px = f.last_px;
+        a.n += f.n;
+        a.bid_qty += f.bid_qty;
+        a.ask_qty += f.ask_qty;
+        a.area += f.area;
+        a.covered += f.covered;
+    }
+
+    void time_pass(const uint64_t* ts, const uint32_t* px, const uint8_t* side, size_t n) {
+        bid_ = ask_ = 0;
+        const uint64_t iv = levels_[0].interval;
+        size_t i = 0;
+        while (i < n) {
+            const uint64_t s = ts[i] / iv * iv;
+            const size_t j = static_cast<size_t>(std::lower_bound(ts + i, ts + n, s + iv) - ts);
+            const bool prev_valid = bid_ && ask_;
+            const double prev_mid = mid();
+            const Acc f = bucket(ts, px, side, i, j, s);
+            for (Level& l : levels_) {
+                fold(l, f, prev_valid, prev_mid);
+            }
+            i = j;
+        }
+        // end of data, no trailing gap
+        for (Level& l : levels_) {
+            if (l.acc.n) {
+                l.out.push_back(to_row(l.acc));
+            }
+        }
+    }
+
+    void tick_pass(const uint64_t* ts, const uint32_t* px, const uint8_t* side, size_t n) {
+        bid_ = ask_ = 0;
+        for (size_t i = 0; i < n; i += tick_rows_) {
+            const size_t j = std::min(n, i + tick_rows_);
+            tick_out_.push_back(to_row(bucket(ts, px, side, i, j, ts[i])));
+        }
+    }
+
+    std::vector<Level> levels_;
+    uint32_t tick_rows_{0};
+    std::vector<BarRow> tick_out_;
+    std::vector<float> signed_;
+    std::vector<double> pq_;
+    std::vector<double> ps_;
+    uint32_t bid_{0};
+    uint32_t ask_{0};
+};
+
+// replays an l2 product and writes one bar product per resolution: <product>-BARS-100ms, -BARS-1s, -BARS-1m,
+// -BARS-<n>T for tick bars
+class BarWriter {
+public:
+    BarWriter(const ReaderOpt& in, std::vector<uint64_t> intervals_ns, uint32_t tick_rows = 0)
+        : in_(in), rs_(std::move(intervals_ns), tick_rows) {
+        for (size_t k = 0; k < rs_.levels(); ++k) {
+            writers_.push_back(make_writer(interval_label(rs_.interval(k))));
+        }
+        if (rs_.tick_rows()) {
+            writers_.push_back(make_writer(std::to_string(rs_.tick_rows()) + "T"));
+        }
+    }
+
+    ~BarWriter() { finish(); }
+
+    static std::string interval_label(uint64_t ns) {
+        static constexpr struct {
+            uint64_t ns;
+            const char* unit;
+        } units[] = {{3'600'000'000'000ull, "h"}, {60'000'000'000ull, "m"}, {1'000'000'000ull, "s"},
+                     {1'000'000ull, "ms"}, {1'000ull, "us"}};
+        for (const auto& u : units) {
+            if (ns % u.ns == 0) {
+                return std::to_string(ns / u.ns) + u.unit;
+            }
+        }
+        return std::to_string(ns) + "ns";
+    }
+
+    // one scan per day feeds every resolution, returns the number of days resampled
+    size_t run() {
+        ReaderT<L2Schema> reader(in_);
+        size_t days = 0;
+        reader.visit_stage_files([&](const ReaderT<L2Schema>::Segment& seg) {
+            rs_.resample(seg);
+            for (size_t k = 0; k < rs_.levels(); ++k) {
+                push(*writers_[k], rs_.bars(k));
+            }
+            if (rs_.tick_rows()) {
+                push(*writers_.back(), rs_.tick_bars());
+            }
+            ++days;
+            return true;
+        });
+        return days;
+    }
+
+    // flushes and closes every bar file
+    void finish() {
+        for (auto& w : writers_) {
+            w->stop();
+            w->join();
+        }
+        writers_.clear();
+    }
+
+private:
+    std::unique_ptr<WriterT<BarSchema>> make_writer(const std::string& label) {
+        auto w = std::make_unique<WriterT<BarSchema>>(WriterOpt(in_.base_dir, in_.product + "-BARS-" + label));
+        w->start();
+        return w;
+    }
+
+    static void push(WriterT<BarSchema>& w, const std::vector<BarRow>& rows) {
+        for (const BarRow& r : rows) {
+            while (!w.enqueue(r)) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    ReaderOpt in_;
+    Resampler rs_;
+    std::vector<std::unique_ptr<WriterT<BarSchema>>> writers_;
+};
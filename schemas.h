@@ -2,6 +2,9 @@
 #include <atomic>
 #include <cstdint>
 
+// column type traits, lets generic code (block codecs) treat each column by type without knowing the row layout
+enum class ColKind : uint8_t { U8, U32, U64, F32 };
+
 struct L2Row {
     uint64_t ts_ns;
     uint32_t price;
@@ -27,6 +30,10 @@ struct L2Schema {
                    : sizeof(uint8_t);
     }
 
+    static constexpr ColKind col_kind(uint32_t i) {
+        return (i == COL_TS) ? ColKind::U64 : (i == COL_PX) ? ColKind::U32 : (i == COL_QTY) ? ColKind::F32 : ColKind::U8;
+    }
+
     static inline uint64_t hour_from_row(const Row& r) {
         const uint64_t s = r.ts_ns / 1'000'000'000ull;
         return (s / 3600ull) * 3600ull;
@@ -68,6 +75,10 @@ struct L3Schema {
         return (i <= COL_TS) ? sizeof(uint64_t) : (i <= COL_SZ) ? sizeof(uint32_t) : sizeof(uint8_t);
     }
 
+    static constexpr ColKind col_kind(uint32_t i) {
+        return (i <= COL_TS) ? ColKind::U64 : (i <= COL_SZ) ? ColKind::U32 : ColKind::U8;
+    }
+
     static inline uint64_t hour_from_row(const Row& r) {
         const uint64_t s = r.ts_ns / 1'000'000'000ull;
         return (s / 3600ull) * 3600ull;
@@ -98,7 +109,9 @@ struct ImbalanceRow {
 };
 
 struct ImbalanceSchema {
-    static constexpr uint32_t COLS = 2;
+    enum : uint32_t { COL_IMB = 0, COL_TS = 1, COL_COUNT = 2 };
+
+    static constexpr uint32_t COLS = COL_COUNT;
     static constexpr const char* MAGIC = "IMBAL\n"; // 6 bytes
     static constexpr uint16_t VERSION = 1;
     using Row = ImbalanceRow;
@@ -107,6 +120,10 @@ struct ImbalanceSchema {
         return (i == 0) ? sizeof(float) : sizeof(uint64_t);
     }
 
+    static constexpr ColKind col_kind(uint32_t i) {
+        return (i == 0) ? ColKind::F32 : ColKind::U64;
+    }
+
     static inline uint64_t hour_from_row(const Row& r) {
         const uint64_t s = r.ts_ns / 1'000'000'000ull;
         return (s / 3600ull) * 3600ull;
@@ -129,7 +146,9 @@ struct VwapRow {
 };
 
 struct VwapSchema {
-    static constexpr uint32_t COLS = 2;
+    enum : uint32_t { COL_VWAP = 0, COL_TS = 1, COL_COUNT = 2 };
+
+    static constexpr uint32_t COLS = COL_COUNT;
     static constexpr const char* MAGIC = "VWAP\n"; // 5 + NUL = 6 bytes copied
     static constexpr uint16_t VERSION = 1;
     using Row = VwapRow;
@@ -138,6 +157,10 @@ struct VwapSchema {
         return (i == 0) ? sizeof(float) : sizeof(uint64_t);
     }
 
+    static constexpr ColKind col_kind(uint32_t i) {
+        return (i == 0) ? ColKind::F32 : ColKind::U64;
+    }
+
     static inline uint64_t hour_from_row(const Row& r) {
         const uint64_t s = r.ts_ns / 1'000'000'000ull;
         return (s / 3600ull) * 3600ull;
@@ -178,6 +201,10 @@ struct VoiSchema {
         }
     }
 
+    static constexpr ColKind col_kind(uint32_t i) {
+        return (i == COL_TS) ? ColKind::U64 : ColKind::U32;
+    }
+
     static inline uint64_t hour_from_row(const Row& r) {
         const uint64_t s = r.ts_ns / 1'000'000'000ull;
         return (s / 3600ull) * 3600ull;
@@ -196,13 +223,67 @@ struct VoiSchema {
     }
 };
 
+// one resampled bar, ts_ns is the bucket start (first row's ts for tick bars)
+struct BarRow {
+    uint64_t ts_ns;
+    uint32_t last_px;
+    uint32_t n;
+    float bid_qty;
+    float ask_qty;
+    float twap_mid; // 0 when no mid was known inside the bar
+};
+
+struct BarSchema {
+    enum : uint32_t { COL_TS = 0, COL_PX = 1, COL_N = 2, COL_BID_QTY = 3, COL_ASK_QTY = 4, COL_MID = 5, COL_COUNT = 6 };
+
+    static constexpr uint32_t COLS = COL_COUNT;
+    static constexpr const char* MAGIC = "BARS\n"; // 5 + NUL = 6 bytes copied
+    static constexpr uint16_t VERSION = 1;
+    using Row = BarRow;
+
+    static constexpr size_t col_size(uint32_t i) {
+        return (i == COL_TS) ? sizeof(uint64_t) : (i <= COL_N) ? sizeof(uint32_t) : sizeof(float);
+    }
+
+    static constexpr ColKind col_kind(uint32_t i) {
+        return (i == COL_TS) ? ColKind::U64 : (i <= COL_N) ? ColKind::U32 : ColKind::F32;
+    }
+
+    static inline uint64_t hour_from_row(const Row& r) {
+        const uint64_t s = r.ts_ns / 1'000'000'000ull;
+        return (s / 3600ull) * 3600ull;
+    }
+
+    static inline void write_row_to_cols(const Row& r, void** c, uint64_t i) {
+        reinterpret_cast<uint64_t*>(c[COL_TS])[i] = r.ts_ns;
+        reinterpret_cast<uint32_t*>(c[COL_PX])[i] = r.last_px;
+        reinterpret_cast<uint32_t*>(c[COL_N])[i] = r.n;
+        reinterpret_cast<float*>(c[COL_BID_QTY])[i] = r.bid_qty;
+        reinterpret_cast<float*>(c[COL_ASK_QTY])[i] = r.ask_qty;
+        reinterpret_cast<float*>(c[COL_MID])[i] = r.twap_mid;
+    }
+
+    static inline void read_row_from_cols(Row& r, const void* const* c, uint64_t i) {
+        r.ts_ns = reinterpret_cast<const uint64_t*>(c[COL_TS])[i];
+        r.last_px = reinterpret_cast<const uint32_t*>(c[COL_PX])[i];
+        r.n = reinterpret_cast<const uint32_t*>(c[COL_N])[i];
+        r.bid_qty = reinterpret_cast<const float*>(c[COL_BID_QTY])[i];
+        r.ask_qty = reinterpret_cast<const float*>(c[COL_ASK_QTY])[i];
+        r.twap_mid = reinterpret_cast<const float*>(c[COL_MID])[i];
+    }
+};
+
+// ColFileHeaderT::layout. files written before the field existed have 0 there
+static constexpr uint16_t COL_LAYOUT_PACKED = 0; // columns back to back right after the header
+static constexpr uint16_t COL_LAYOUT_ALIGNED = 1; // every column starts on a multiple of col_align
+
 template <class Schema>
 struct alignas(64) ColFileHeaderT {
     char magic[6];
     uint16_t header_size;
     uint16_t version;
-    uint16_t pad16{0};
-    uint32_t _pad32{0};
+    uint16_t layout{COL_LAYOUT_PACKED};
+    uint32_t col_align{0}; // bytes, 0 for packed files
     char product[16];
     uint64_t hour_epoch_start;
     uint64_t rows;
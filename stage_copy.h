@@ -0,0 +1,298 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// bulk copies of column ranges into the stage. when source and destination are both 64 B aligned (columns of
+// aligned layout files into stage slots, windows of whole cache lines) the body runs as aligned vector loads and
+// stores, 512 bit with -mavx512f, 256 bit with -mavx2. only up to VECTOR_MAX: past l2 the stores pay for the read
+// for ownership of every line and glibc's rep movsb / non temporal path is faster, so bigger copies, unaligned ones
+// and builds without either extension go to memcpy
+struct StageCopy {
+    static constexpr size_t ALIGN = 64;
+    static constexpr size_t VECTOR_MAX = 512u << 10;
+
+    static bool aligned(const void* p) noexcept { return (reinterpret_cast<uintptr_t>(p) & (ALIGN - 1)) == 0; }
+
+    static void copy(void* dst, const void* src, size_t bytes) noexcept {
+#if defined(__AVX512F__) || defined(__AVX2__)
+        if (bytes >= 4 * ALIGN && bytes <= VECTOR_MAX && aligned(dst) && aligned(src)) {
+            const size_t body = bytes & ~(4 * ALIGN - 1);
+            copy_aligned(static_cast<std::byte*>(dst), static_cast<const std::byte*>(src), body);
+            if (bytes > body) {
+                std::memcpy(static_cast<std::byte*>(dst) + body, static_cast<const std::byte*>(src) + body,
+                            bytes - body);
+            }
+            return;
+        }
+#endif
+        std::memcpy(dst, src, bytes);
+    }
+
+    // same copy around the cache: unaligned loads, non temporal stores from the first 64 B boundary of dst, so a
+    // day far bigger than the llc does not evict everything else on its way into the stage. fenced before it
+    // returns, the stores are visible to whoever the caller signals next
+    static void stream(void* dst, const void* src, size_t bytes) noexcept {
+#if defined(__AVX512F__) || defined(__AVX2__)
+        auto* d = static_cast<std::byte*>(dst);
+        const auto* s = static_cast<const std::byte*>(src);
+        prefault(s, bytes);
+        const size_t head = std::min(bytes, (ALIGN - (reinterpret_cast<uintptr_t>(d) & (ALIGN - 1))) & (ALIGN - 1));
+        std::memcpy(d, s, head);
+        const size_t body = (bytes - head) & ~(4 * ALIGN - 1);
+        stream_body(d + head, s + head, body);
+        std::memcpy(d + head + body, s + head + body, bytes - head - body);
+        _mm_sfence();
+#else
+        std::memcpy(dst, src, bytes);
+#endif
+    }
+
+private:
+    // one load per 4 KiB page before the stores start: a fault in the middle of the loop drains the write combining
+    // buffers half full, and every partial line costs a read-modify-write in memory
+    static void prefault(const std::byte* s, size_t bytes) noexcept {
+        uint8_t sink = 0;
+        for (size_t off = 0; off < bytes; off += 4096) {
+            sink ^= *reinterpret_cast<const volatile uint8_t*>(s + off);
+        }
+        if (bytes) {
+            sink ^= *reinterpret_cast<const volatile uint8_t*>(s + bytes - 1);
+        }
+        asm volatile("" : : "r"(sink));
+    }
+
+#if defined(__AVX512F__)
+    static void stream_body(std::byte* d, const std::byte* s, size_t bytes) noexcept {
+        for (size_t i = 0; i < bytes; i += 4 * ALIGN) {
+            const __m512i a = _mm512_loadu_si512(s + i);
+            const __m512i b = _mm512_loadu_si512(s + i + 64);
+            const __m512i c = _mm512_loadu_si512(s + i + 128);
+            const __m512i e = _mm512_loadu_si512(s + i + 192);
+            _mm512_stream_si512(reinterpret_cast<__m512i*>(d + i), a);
+            _mm512_stream_si512(reinterpret_cast<__m512i*>(d + i + 64), b);
+            _mm512_stream_si512(reinterpret_cast<__m512i*>(d + i + 128), c);
+            _mm512_stream_si512(reinterpret_cast<__m512i*>(d + i + 192), e);
+        }
+    }
+#elif defined(__AVX2__)
+    static void stream_body(std::byte* d, const std::byte* s, size_t bytes) noexcept {
+        for (size_t i = 0; i < bytes; i += 4 * ALIGN) {
+            for (size_t k = 0; k < 4 * ALIGN; k += 128) {
+                const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i + k));
+                const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i + k + 32));
+                const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i + k + 64));
+                const __m256i e = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i + k + 96));
+                _mm256_stream_si256(reinterpret_cast<__m256i*>(d + i + k), a);
+                _mm256_stream_si256(reinterpret_cast<__m256i*>(d + i + k + 32), b);
+                _mm256_stream_si256(reinterpret_cast<__m256i*>(d + i + k + 64), c);
+                _mm256_stream_si256(reinterpret_cast<__m256i*>(d + i + k + 96), e);
+            }
+        }
+    }
+#endif
+
+
+#if defined(__AVX512F__)
+    // 4 cache lines per iteration, bytes a multiple of 256
+    static void copy_aligned(std::byte* d, const std::byte* s, size_t bytes) noexcept {
+        for (size_t i = 0; i < bytes; i += 4 * ALIGN) {
+            const __m512i a = _mm512_load_si512(s + i);
+            const __m512i b = _mm512_load_si512(s + i + 64);
+            const __m512i c = _mm512_load_si512(s + i + 128);
+            const __m512i e = _mm512_load_si512(s + i + 192);
+            _mm512_store_si512(d + i, a);
+            _mm512_store_si512(d + i + 64, b);
+            _mm512_store_si512(d + i + 128, c);
+            _mm512_store_si512(d + i + 192, e);
+        }
+    }
+#elif defined(__AVX2__)
+    static void copy_aligned(std::byte* d, const std::byte* s, size_t bytes) noexcept {
+        for (size_t i = 0; i < bytes; i += 4 * ALIGN) {
+            for (size_t k = 0; k < 4 * ALIGN; k += 128) {
+                const __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i*>(s + i + k));
+                const __m256i b = _mm256_load_si256(reinterpret_cast<const __m256i*>(s + i + k + 32));
+                const __m256i c = _mm256_load_si256(reinterpret_cast<const __m256i*>(s + i + k + 64));
+                const __m256i e = _mm256_load_si256(reinterpret_cast<const __m256i*>(s + i + k + 96));
+                _mm256_store_si256(reinterpret_cast<__m256i*>(d + i + k), a);
+                _mm256_store_si256(reinterpret_cast<__m256i*>(d + i + k + 32), b);
+                _mm256_store_si256(reinterpret_cast<__m256i*>(d + i + k + 64), c);
+                _mm256_store_si256(reinterpret_cast<__m256i*>(d + i + k + 96), e);
+            }
+        }
+    }
+#endif
+};
+
+// copies a day's columns into the stage on the calling thread plus threads - 1 helpers (started on first use).
+// the columns are cut into PIECE sized pieces that every thread pulls off one counter, so page faults on a freshly
+// mapped source are taken in parallel too. a run of at least stream_bytes goes through StageCopy::stream.
+// stats() has bytes and wall time over all runs, report() prints them as GB/s
+class StageCopier {
+public:
+    struct Job {
+        void* dst;
+        const void* src;
+        size_t bytes;
+    };
+
+    struct Stats {
+        uint64_t runs{0};
+        uint64_t bytes{0};
+        uint64_t streamed_bytes{0};
+        uint64_t ns{0};
+
+        double gbps() const noexcept { return ns ? static_cast<double>(bytes) / static_cast<double>(ns) : 0.0; }
+    };
+
+    static constexpr size_t PIECE = 2u << 20;
+
+    StageCopier(uint32_t threads, size_t stream_bytes)
+        : threads_(std::max(1u, threads)), stream_bytes_(stream_bytes) {}
+
+    ~StageCopier() {
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (std::thread& t : helpers_) {
+            t.join();
+        }
+    }
+
+    StageCopier(const StageCopier&) = delete;
+    StageCopier& operator=(const StageCopier&) = delete;
+
+    uint32_t threads() const noexcept { return threads_; }
+    const Stats& stats() const noexcept { return stats_; }
+
+    void run(const Job* jobs, size_t n) {
+        const auto t0 = std::chrono::steady_clock::now();
+        size_t total = 0;
+        for (size_t i = 0; i < n; ++i) {
+            total += jobs[i].bytes;
+        }
+        const bool stream = total >= stream_bytes_;
+        if (threads_ == 1 || total <= PIECE) {
+            for (size_t i = 0; i < n; ++i) {
+                stream ? StageCopy::stream(jobs[i].dst, jobs[i].src, jobs[i].bytes)
+                       : StageCopy::copy(jobs[i].dst, jobs[i].src, jobs[i].bytes);
+            }
+        }
+        else {
+            run_parallel(jobs, n, stream);
+        }
+        stats_.runs += 1;
+        stats_.bytes += total;
+        stats_.streamed_bytes += stream ? total : 0;
+        stats_.ns += static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count());
+    }
+
+    void report(std::ostream& os) const {
+        char line[160];
+        std::snprintf(line, sizeof(line), "[stage] %llu copies, %.2f GB (%.2f GB streamed) in %.1f ms, %.2f GB/s on %u threads\n",
+                      static_cast<unsigned long long>(stats_.runs), static_cast<double>(stats_.bytes) * 1e-9,
+                      static_cast<double>(stats_.streamed_bytes) * 1e-9, static_cast<double>(stats_.ns) * 1e-6,
+                      stats_.gbps(), threads_);
+        os << line;
+        os.flush();
+    }
+
+private:
+    struct Piece {
+        std::byte* dst;
+        const std::byte* src;
+        size_t bytes;
+    };
+
+    void run_parallel(const Job* jobs, size_t n, bool stream) {
+        if (helpers_.empty()) {
+            for (uint32_t i = 1; i < threads_; ++i) {
+                helpers_.emplace_back([this] { helper(); });
+            }
+        }
+        {
+            std::unique_lock<std::mutex> lk(mu_);
+            // a helper that woke too late for the last run may still be walking pieces_
+            done_.wait(lk, [&] { return busy_ == 0; });
+            pieces_.clear();
+            for (size_t i = 0; i < n; ++i) {
+                auto* d = static_cast<std::byte*>(jobs[i].dst);
+                const auto* s = static_cast<const std::byte*>(jobs[i].src);
+                for (size_t off = 0; off < jobs[i].bytes; off += PIECE) {
+                    pieces_.push_back(Piece{d + off, s + off, std::min(PIECE, jobs[i].bytes - off)});
+                }
+            }
+            stream_ = stream;
+            next_.store(0, std::memory_order_relaxed);
+            left_.store(pieces_.size(), std::memory_order_relaxed);
+            ++gen_;
+        }
+        wake_.notify_all();
+        drain();
+        // every piece done and no helper still looking at pieces_, the next run may refill it
+        std::unique_lock<std::mutex> lk(mu_);
+        done_.wait(lk, [&] { return left_.load(std::memory_order_acquire) == 0 && busy_ == 0; });
+    }
+
+    void drain() {
+        for (size_t i = next_.fetch_add(1, std::memory_order_relaxed); i < pieces_.size();
+             i = next_.fetch_add(1, std::memory_order_relaxed)) {
+            const Piece& p = pieces_[i];
+            stream_ ? StageCopy::stream(p.dst, p.src, p.bytes) : StageCopy::copy(p.dst, p.src, p.bytes);
+            if (left_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard<std::mutex> lk(mu_);
+                done_.notify_all();
+            }
+        }
+    }
+
+    void helper() {
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> lk(mu_);
+        for (;;) {
+            wake_.wait(lk, [&] { return stop_ || gen_ != seen; });
+            if (stop_) {
+                return;
+            }
+            seen = gen_;
+            ++busy_;
+            lk.unlock();
+            drain();
+            lk.lock();
+            if (--busy_ == 0) {
+                done_.notify_all();
+            }
+        }
+    }
+
+    const uint32_t threads_;
+    const size_t stream_bytes_;
+    Stats stats_;
+    std::vector<std::thread> helpers_;
+    std::mutex mu_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    std::vector<Piece> pieces_;
+    std::atomic<size_t> next_{0};
+    std::atomic<size_t> left_{0};
+    bool stream_{false};
+    uint64_t gen_{0};
+    uint32_t busy_{0};
+    bool stop_{false};
+};
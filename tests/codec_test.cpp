@@ -0,0 +1,384 @@
+// round trips every ColEnc/FloatEnc through encode/decode, with columns at the value extremes, see README for the build line
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include "../col_codec.h"
+#include "../float_codec.h"
+#include "../block_codec.h"
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    if (!ok) {
+        std::fprintf(stderr, "FAIL %s\n", what.c_str());
+        ++failures;
+    }
+}
+
+constexpr uint64_t U64_MAX = std::numeric_limits<uint64_t>::max();
+constexpr uint64_t U32_MAX = std::numeric_limits<uint32_t>::max();
+
+std::set<ColEnc> col_seen;
+std::set<FloatEnc> float_seen;
+
+// width is the column type size, vals must fit in it
+void col_roundtrip(const char* name, const std::vector<uint64_t>& vals, uint32_t width) {
+    std::vector<uint8_t> buf;
+    const ColEnc enc = ColCodec::encode(vals.data(), vals.size(), width, buf);
+    col_seen.insert(enc);
+    const std::string what = std::string(name) + " (enc " + std::to_string(static_cast<int>(enc)) + ")";
+
+    std::vector<uint64_t> out(vals.size(), 0xdeadbeef);
+    ColCodec::decode(enc, buf.data(), buf.size(), vals.size(), width, out.data());
+    check(out == vals, what + " u64 decode");
+
+    if (width == sizeof(uint32_t)) {
+        std::vector<uint32_t> out32(vals.size(), 0xdeadbeef);
+        ColCodec::decode_u32(enc, buf.data(), buf.size(), vals.size(), out32.data());
+        check(std::equal(out32.begin(), out32.end(), vals.begin()), what + " u32 decode");
+    }
+}
+
+// compares bit patterns so nan payloads and -0.0 have to survive too
+void float_roundtrip(const char* name, const std::vector<float>& vals) {
+    std::vector<uint8_t> buf;
+    const FloatEnc enc = FloatCodec::encode(vals.data(), vals.size(), buf);
+    float_seen.insert(enc);
+    const std::string what = std::string(name) + " (enc " + std::to_string(static_cast<int>(enc)) + ")";
+
+    std::vector<float> out(vals.size(), 1.0f);
+    FloatCodec::decode(enc, buf.data(), buf.size(), vals.size(), out.data());
+    check(std::memcmp(out.data(), vals.data(), vals.size() * sizeof(float)) == 0, what);
+}
+
+template <class T>
+std::vector<T> repeat(std::initializer_list<T> pattern, size_t n) {
+    std::vector<T> v;
+    v.reserve(n);
+    while (v.size() < n) {
+        for (T x : pattern) {
+            if (v.size() == n) {
+                break;
+            }
+            v.push_back(x);
+        }
+    }
+    return v;
+}
+
+template <class Fn>
+void check_throws(Fn&& fn, const std::string& what) {
+    bool threw = false;
+    try {
+        fn();
+    }
+    catch (const std::runtime_error&) {
+        threw = true;
+    }
+    check(threw, what);
+}
+
+// a DICT column whose header or indices were damaged has to throw, not decode garbage
+void dict_corrupt_cases() {
+    std::vector<uint64_t> vals = repeat<uint64_t>({7, U64_MAX, 0, 42, 9}, 100);
+    std::vector<uint8_t> good;
+    check(ColCodec::encode(vals.data(), vals.size(), 8, good) == ColEnc::DICT, "dict picked for 5 distinct values");
+    std::vector<uint64_t> out(vals.size());
+
+    auto decode_with = [&](auto edit) {
+        std::vector<uint8_t> buf = good;
+        ColCodec::DictHeader h{};
+        std::memcpy(&h, buf.data(), sizeof(h));
+        edit(h, buf);
+        std::memcpy(buf.data(), &h, sizeof(h));
+        return [buf, &out, n = vals.size()] {
+            ColCodec::decode(ColEnc::DICT, buf.data(), buf.size(), n, 8, out.data());
+        };
+    };
+    check_throws(decode_with([](ColCodec::DictHeader& h, std::vector<uint8_t>&) { h.bw = 60; }), "dict bw 60");
+    check_throws(decode_with([](ColCodec::DictHeader& h, std::vector<uint8_t>&) { h.bw = 4; }), "dict bw over k");
+    check_throws(decode_with([](ColCodec::DictHeader& h, std::vector<uint8_t>& b) {
+        h.k = ColCodec::MAX_DICT + 1;
+        b.resize(b.size() + 8 * ColCodec::MAX_DICT);
+    }), "dict k over MAX_DICT");
+    // 5 entries packed at 3 bits, index 7 is past the dictionary
+    check_throws(decode_with([](ColCodec::DictHeader&, std::vector<uint8_t>& b) {
+        b[sizeof(ColCodec::DictHeader) + 5 * 8] |= 0x07;
+    }), "dict index past k");
+}
+
+void col_cases() {
+    std::mt19937_64 rng(7);
+    constexpr size_t N = 1024;
+    std::vector<uint64_t> v(N);
+
+    col_roundtrip("const max", std::vector<uint64_t>(N, U64_MAX), 8);
+    col_roundtrip("const zero", std::vector<uint64_t>(N, 0), 8);
+
+    // bw_of(max - min) used to wrap to 1 for these and pick a one bit FOR
+    col_roundtrip("alternating 0/max", repeat<uint64_t>({0, U64_MAX}, N), 8);
+    col_roundtrip("alternating 5/5+2^63", repeat<uint64_t>({5, 5 + (1ull << 63)}, N), 8);
+    col_roundtrip("alternating 0/u32 max", repeat<uint64_t>({0, U32_MAX}, N), 4);
+
+    for (auto& x : v) {
+        x = rng();
+    }
+    col_roundtrip("random u64", v, 8);
+    for (auto& x : v) {
+        x = rng() & U32_MAX;
+    }
+    col_roundtrip("random u32", v, 4);
+
+    // narrow spread just under the top of the range
+    for (auto& x : v) {
+        x = U64_MAX - (rng() & 0xfffff);
+    }
+    col_roundtrip("for near u64 max", v, 8);
+    for (auto& x : v) {
+        x = U32_MAX - (rng() & 0xfff);
+    }
+    col_roundtrip("for near u32 max", v, 4);
+    for (auto& x : v) {
+        x = rng() & 0xfffff;
+    }
+    col_roundtrip("for near zero", v, 8);
+
+    // random walks that wrap through zero
+    uint64_t w = 3;
+    for (auto& x : v) {
+        x = w;
+        w += static_cast<uint64_t>(static_cast<int64_t>(rng() % 257) - 128);
+    }
+    col_roundtrip("walk through u64 wrap", v, 8);
+    uint32_t w32 = 5;
+    for (auto& x : v) {
+        x = w32;
+        w32 += static_cast<uint32_t>(static_cast<int32_t>(rng() % 65) - 32);
+    }
+    col_roundtrip("walk through u32 wrap", v, 4);
+
+    // deltas spanning the whole signed range, per miniblock spread stays narrow
+    for (size_t i = 0; i < N; ++i) {
+        v[i] = i * 0x4000'0000'0000'0001ull + (rng() & 0xff);
+    }
+    col_roundtrip("huge stride with noise", v, 8);
+
+    // few wide deltas in a narrow walk, one bw for the whole block beats miniblocks
+    w = U64_MAX - 10;
+    for (size_t i = 0; i < 64; ++i) {
+        v[i] = w;
+        w += 1 + (rng() & 1);
+    }
+    col_roundtrip("short delta wrap", std::vector<uint64_t>(v.begin(), v.begin() + 64), 8);
+    for (size_t i = 0; i < 9; ++i) {
+        v[i] = (i * 3) ^ (i & 1);
+    }
+    col_roundtrip("tiny delta", std::vector<uint64_t>(v.begin(), v.begin() + 9), 8);
+
+    // sampled timestamps with a few gaps, starting right below the wrap
+    for (size_t i = 0; i < N; ++i) {
+        v[i] = U64_MAX - 1000 + i * 1'000'000 + (i % 97 == 0 ? 17 : 0);
+    }
+    col_roundtrip("stride through wrap", v, 8);
+    for (size_t i = 0; i < N; ++i) {
+        v[i] = (U32_MAX - 10 + i * 3) & U32_MAX;
+    }
+    col_roundtrip("stride u32 wrap", v, 4);
+
+    // long runs of values too far apart for FOR
+    for (size_t i = 0; i < N; ++i) {
+        v[i] = (i / 100) * 1000 + 77;
+    }
+    col_roundtrip("runs", v, 8);
+    for (size_t i = 0; i < N; ++i) {
+        v[i] = (i / 200) % 2 ? U64_MAX : 0;
+    }
+    col_roundtrip("runs 0/max", v, 8);
+
+    // many distinct values spread over the full range, repeated in random order
+    std::vector<uint64_t> dict(200);
+    for (auto& d : dict) {
+        d = rng();
+    }
+    dict[0] = 0;
+    dict[1] = U64_MAX;
+    for (auto& x : v) {
+        x = dict[rng() % dict.size()];
+    }
+    col_roundtrip("dict extremes", v, 8);
+
+    col_roundtrip("single max", {U64_MAX}, 8);
+    col_roundtrip("pair 0/max", {0, U64_MAX}, 8);
+    col_roundtrip("u8 flags", repeat<uint64_t>({0, 255, 1, 0, 0, 255}, N), 1);
+
+    for (ColEnc e : {ColEnc::RAW, ColEnc::CONST, ColEnc::FOR, ColEnc::DELTA, ColEnc::RLE, ColEnc::DICT,
+                     ColEnc::DELTA_FOR, ColEnc::STRIDE}) {
+        check(col_seen.count(e) == 1, "ColEnc " + std::to_string(static_cast<int>(e)) + " not exercised");
+    }
+}
+
+void float_cases() {
+    std::mt19937_64 rng(11);
+    constexpr size_t N = 1024;
+    const float inf = std::numeric_limits<float>::infinity();
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    const float fmax = std::numeric_limits<float>::max();
+    const float fmin = std::numeric_limits<float>::denorm_min();
+    std::vector<float> v(N);
+
+    for (auto& x : v) {
+        const uint32_t u = static_cast<uint32_t>(rng());
+        std::memcpy(&x, &u, sizeof(x));
+    }
+    v[0] = nan;
+    v[1] = -inf;
+    v[2] = fmax;
+    v[3] = -fmax;
+    v[4] = fmin;
+    v[5] = -0.0f;
+    float_roundtrip("random bits", v);
+
+    float_roundtrip("const extremes", repeat<float>({fmax, fmax, fmax, -0.0f, -0.0f, -0.0f, -0.0f}, N));
+    float_roundtrip("alternating max/denorm", repeat<float>({fmax, -fmin}, N));
+    float_roundtrip("nan/inf", repeat<float>({nan, inf, -inf, 0.0f}, N));
+
+    // byte planes that differ only in the low bytes
+    for (auto& x : v) {
+        const uint32_t u = 0x7f7f'0000u | static_cast<uint32_t>(rng() & 0xffff);
+        std::memcpy(&x, &u, sizeof(x));
+    }
+    float_roundtrip("shuffle near max", v);
+
+    // lot sized quantities
+    for (auto& x : v) {
+        x = static_cast<float>(rng() % 100'000) * 0.01f;
+    }
+    float_roundtrip("decimal lots", v);
+    for (auto& x : v) {
+        x = static_cast<float>(rng() % 1'000'000) * 16.0f;
+    }
+    float_roundtrip("large integer lots", v);
+
+    // smooth same sign series, the bit patterns move by small deltas
+    float f = 1.0e30f;
+    for (auto& x : v) {
+        x = f;
+        f = std::nextafter(f, fmax);
+        if (rng() % 3 == 0) {
+            f = std::nextafter(f, fmax);
+        }
+    }
+    float_roundtrip("bits delta near max", v);
+
+    // sticky sizes, about half the rows repeat and the rest flip a window of mantissa bits
+    f = -fmax;
+    for (auto& x : v) {
+        if (rng() % 2 == 0) {
+            uint32_t u;
+            std::memcpy(&u, &f, sizeof(u));
+            u ^= static_cast<uint32_t>(rng() & 0xfff) << 4;
+            std::memcpy(&f, &u, sizeof(f));
+        }
+        x = f;
+    }
+    float_roundtrip("gorilla near -max", v);
+
+    float_roundtrip("single nan", {nan});
+    float_roundtrip("single denorm", {-fmin});
+
+    for (FloatEnc e : {FloatEnc::RAW, FloatEnc::GORILLA, FloatEnc::SHUFFLE, FloatEnc::DECIMAL,
+                       FloatEnc::BITS_DELTA}) {
+        check(float_seen.count(e) == 1, "FloatEnc " + std::to_string(static_cast<int>(e)) + " not exercised");
+    }
+}
+
+// L2Row through both l2 codecs, L2TBlockCodec keeps ts at 1 ms so those rows sit on ms boundaries
+template <class Codec>
+void l2_block_roundtrip(const char* name, uint64_t ts_step) {
+    std::vector<L2Row> rows(500);
+    for (size_t i = 0; i < rows.size(); ++i) {
+        rows[i] = L2Row{1'704'204'000'000'000'000ull + i * ts_step, i % 2 ? 0u : static_cast<uint32_t>(U32_MAX - i),
+                        i % 3 ? 0.25f * static_cast<float>(i) : std::numeric_limits<float>::max(),
+                        static_cast<uint8_t>(i & 1)};
+    }
+    std::vector<uint8_t> buf;
+    Codec::encode_block(rows.data(), static_cast<uint32_t>(rows.size()), buf);
+    std::vector<L2Row> out;
+    Codec::decode_block(buf.data(), buf.size(), out);
+    bool same = out.size() == rows.size();
+    for (size_t i = 0; same && i < rows.size(); ++i) {
+        same = out[i].ts_ns == rows[i].ts_ns && out[i].price == rows[i].price && out[i].qty == rows[i].qty &&
+               out[i].side == rows[i].side;
+    }
+    check(same, name);
+}
+
+// off + len of a damaged column header must not wrap past the block length check
+void block_header_cases() {
+    using Codec = L3BlockCodec<L3Schema>;
+    std::vector<L3Row> rows(300);
+    for (size_t i = 0; i < rows.size(); ++i) {
+        rows[i] = L3Row{U64_MAX - i, 1'000'000 + i * 7, static_cast<uint32_t>(450'000 + i % 13),
+                        static_cast<uint32_t>(i % 5 + 1), static_cast<uint8_t>(i % 3), static_cast<uint8_t>(i & 1)};
+    }
+    std::vector<uint8_t> buf;
+    Codec::encode_block(rows.data(), static_cast<uint32_t>(rows.size()), buf);
+
+    std::vector<L3Row> out;
+    const size_t used = Codec::decode_block(buf.data(), buf.size(), out);
+    bool same = used == buf.size() && out.size() == rows.size();
+    for (size_t i = 0; same && i < rows.size(); ++i) {
+        same = out[i].id == rows[i].id && out[i].ts_ns == rows[i].ts_ns && out[i].price == rows[i].price &&
+               out[i].size == rows[i].size && out[i].action == rows[i].action && out[i].side == rows[i].side;
+    }
+    check(same, "l3 block round trip");
+
+    // a flipped bit in n_rows must be caught before anything is sized from it
+    Codec::BlockHeader hdr{};
+    std::memcpy(&hdr, buf.data(), sizeof(hdr));
+    for (uint32_t bad : {hdr.n_rows ^ (1u << 30), hdr.n_rows ^ 1u}) {
+        std::vector<uint8_t> flipped = buf;
+        Codec::BlockHeader h = hdr;
+        h.n_rows = bad;
+        std::memcpy(flipped.data(), &h, sizeof(h));
+        check_throws([&] { Codec::decode_block(flipped.data(), flipped.size(), out, hdr.n_rows); },
+                     "n_rows " + std::to_string(bad) + " against the index count");
+    }
+    check_throws([&] {
+        std::vector<uint8_t> flipped = buf;
+        Codec::BlockHeader h = hdr;
+        h.n_rows = MAX_BLOCK_ROWS + 1;
+        std::memcpy(flipped.data(), &h, sizeof(h));
+        Codec::decode_block(flipped.data(), flipped.size(), out);
+    }, "n_rows over MAX_BLOCK_ROWS without an index");
+
+    hdr.off[L3Schema::COL_ID] = 0xffff'fff0u;
+    hdr.len[L3Schema::COL_ID] = 0x20u;
+    std::memcpy(buf.data(), &hdr, sizeof(hdr));
+    check_throws([&] { Codec::decode_block(buf.data(), buf.size(), out); }, "wrapping column span rejected");
+}
+
+} // namespace
+
+int main() {
+    col_cases();
+    dict_corrupt_cases();
+    float_cases();
+    l2_block_roundtrip<L2TBlockCodec<L2Schema>>("l2t block round trip", 1'000'000);
+    l2_block_roundtrip<SchemaBlockCodec<L2Schema>>("l2 schema block round trip", 137);
+    block_header_cases();
+    if (failures != 0) {
+        std::fprintf(stderr, "%d codec check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("codec round trips ok\n");
+    return 0;
+}
@@ -0,0 +1,277 @@
+#pragma once
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#endif
+
+#ifndef __NR_io_uring_enter
+#define __NR_io_uring_enter 426
+#endif
+
+// bare io_uring over the raw syscalls, only what bulk reads into caller memory need. one ring per thread
+class Uring {
+public:
+    struct Completion {
+        uint64_t user;
+        int32_t res;
+    };
+
+    explicit Uring(uint32_t entries) {
+        io_uring_params p{};
+        fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &p));
+        if (fd_ < 0) {
+            err_ = errno;
+            return;
+        }
+        sq_entries_ = p.sq_entries;
+
+        sq_len_ = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+        cq_len_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        const bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) {
+            sq_len_ = cq_len_ = std::max(sq_len_, cq_len_);
+        }
+        sq_ring_ = ::mmap(nullptr, sq_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+        cq_ring_ = single ? sq_ring_
+                          : ::mmap(nullptr, cq_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                                   IORING_OFF_CQ_RING);
+        sqes_len_ = p.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = ::mmap(nullptr, sqes_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+        if (sq_ring_ == MAP_FAILED || cq_ring_ == MAP_FAILED || sqes == MAP_FAILED) {
+            err_ = errno;
+            sqes_ = sqes == MAP_FAILED ? nullptr : static_cast<io_uring_sqe*>(sqes);
+            sq_ring_ = sq_ring_ == MAP_FAILED ? nullptr : sq_ring_;
+            cq_ring_ = cq_ring_ == MAP_FAILED ? nullptr : cq_ring_;
+            release();
+            return;
+        }
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+        auto* sq = static_cast<uint8_t*>(sq_ring_);
+        sq_head_ = reinterpret_cast<uint32_t*>(sq + p.sq_off.head);
+        sq_tail_ = reinterpret_cast<uint32_t*>(sq + p.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<uint32_t*>(sq + p.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<uint32_t*>(sq + p.sq_off.array);
+
+        auto* cq = static_cast<uint8_t*>(cq_ring_);
+        cq_head_ = reinterpret_cast<uint32_t*>(cq + p.cq_off.head);
+        cq_tail_ = reinterpret_cast<uint32_t*>(cq + p.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<uint32_t*>(cq + p.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+    }
+
+    ~Uring() { release(); }
+
+    Uring(const Uring&) = delete;
+    Uring& operator=(const Uring&) = delete;
+
+    bool ok() const noexcept { return sqes_ != nullptr; }
+    int error() const noexcept { return err_; }
+    uint32_t depth() const noexcept { return sq_entries_; }
+    uint32_t in_flight() const noexcept { return in_flight_; }
+    uint32_t pending() const noexcept { return in_flight_ + queued_; } // submitted or queued
+
+    // queues a read of len bytes at off into buf, false when the submission queue is full
+    bool read(int fd, void* buf, uint32_t len, uint64_t off, uint64_t user) {
+        const uint32_t tail = *sq_tail_;
+        if (tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_) {
+            return false;
+        }
+        const uint32_t idx = tail & sq_mask_;
+        io_uring_sqe& e = sqes_[idx];
+        std::memset(&e, 0, sizeof(e));
+        e.opcode = IORING_OP_READ;
+        e.fd = fd;
+        e.addr = reinterpret_cast<uint64_t>(buf);
+        e.len = len;
+        e.off = off;
+        e.user_data = user;
+        sq_array_[idx] = idx;
+        __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+        ++queued_;
+        return true;
+    }
+
+    // submits everything queued and blocks until at least wait completions are ready, -errno on failure
+    int submit(uint32_t wait) {
+        for (;;) {
+            const uint32_t flags = wait ? IORING_ENTER_GETEVENTS : 0;
+            const long r = ::syscall(__NR_io_uring_enter, fd_, queued_, std::min(wait, in_flight_ + queued_), flags,
+                                     nullptr, 0);
+            if (r < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return -errno;
+            }
+            in_flight_ += static_cast<uint32_t>(r);
+            queued_ -= static_cast<uint32_t>(r);
+            return static_cast<int>(r);
+        }
+    }
+
+    // drops what was queued but never submitted. without SQPOLL the kernel only reads the submission ring inside
+    // io_uring_enter, so rewinding the tail takes those entries back
+    void discard_queued() noexcept {
+        __atomic_store_n(sq_tail_, *sq_tail_ - queued_, __ATOMIC_RELEASE);
+        queued_ = 0;
+    }
+
+    // one finished request, false when none is ready
+    bool reap(Completion& c) {
+        const uint32_t head = *cq_head_;
+        if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+            return false;
+        }
+        const io_uring_cqe& e = cqes_[head & cq_mask_];
+        c.user = e.user_data;
+        c.res = e.res;
+        __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+        --in_flight_;
+        return true;
+    }
+
+private:
+    void release() {
+        if (sqes_) {
+            ::munmap(sqes_, sqes_len_);
+            sqes_ = nullptr;
+        }
+        if (cq_ring_ && cq_ring_ != sq_ring_) {
+            ::munmap(cq_ring_, cq_len_);
+        }
+        if (sq_ring_) {
+            ::munmap(sq_ring_, sq_len_);
+        }
+        sq_ring_ = cq_ring_ = nullptr;
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    int fd_{-1};
+    int err_{0};
+    void* sq_ring_{nullptr};
+    void* cq_ring_{nullptr};
+    size_t sq_len_{0};
+    size_t cq_len_{0};
+    size_t sqes_len_{0};
+    io_uring_sqe* sqes_{nullptr};
+    uint32_t* sq_head_{nullptr};
+    uint32_t* sq_tail_{nullptr};
+    uint32_t* sq_array_{nullptr};
+    uint32_t sq_mask_{0};
+    uint32_t sq_entries_{0};
+    uint32_t* cq_head_{nullptr};
+    uint32_t* cq_tail_{nullptr};
+    uint32_t cq_mask_{0};
+    io_uring_cqe* cqes_{nullptr};
+    uint32_t queued_{0};
+    uint32_t in_flight_{0};
+};
+
+// reads a list of (fd, file offset, length, destination) ranges with up to depth requests in flight, split into chunks
+// of chunk bytes. short reads are resubmitted for the rest, false on the first error or unexpected end of file. the
+// ring is left with nothing pending on return unless the final wait failed, see drain
+class UringBulkRead {
+public:
+    struct Range {
+        int fd;
+        uint64_t off;
+        uint64_t len;
+        void* dst;
+    };
+
+    static bool run(Uring& ring, const std::vector<Range>& ranges, uint32_t chunk, int& err) {
+        struct Piece {
+            int fd;
+            uint64_t off;
+            uint32_t len;
+            std::byte* dst;
+        };
+        std::vector<Piece> pieces;
+        for (const Range& r : ranges) {
+            for (uint64_t done = 0; done < r.len; done += chunk) {
+                const uint32_t n = static_cast<uint32_t>(std::min<uint64_t>(chunk, r.len - done));
+                pieces.push_back(Piece{r.fd, r.off + done, n, static_cast<std::byte*>(r.dst) + done});
+            }
+        }
+        err = 0;
+        if (ring.pending()) {
+            err = EBUSY; // completions from an earlier run would be taken for ours
+            return false;
+        }
+        size_t next = 0;
+        size_t left = pieces.size();
+        while (left) {
+            while (next < pieces.size() && ring.pending() < ring.depth()) {
+                const Piece& p = pieces[next];
+                if (!ring.read(p.fd, p.dst, p.len, p.off, next)) {
+                    break;
+                }
+                ++next;
+            }
+            if (const int r = ring.submit(1); r < 0) {
+                err = -r;
+                drain(ring);
+                return false;
+            }
+            Uring::Completion c{};
+            while (ring.reap(c)) {
+                Piece& p = pieces[c.user];
+                if (c.res == -EAGAIN || c.res == -EINTR) {
+                    c.res = 0; // resubmit untouched
+                }
+                else if (c.res <= 0) {
+                    err = c.res < 0 ? -c.res : EIO;
+                    drain(ring);
+                    return false;
+                }
+                p.off += static_cast<uint64_t>(c.res);
+                p.dst += c.res;
+                p.len -= static_cast<uint32_t>(c.res);
+                if (p.len == 0) {
+                    --left;
+                }
+                else if (!ring.read(p.fd, p.dst, p.len, p.off, c.user)) {
+                    err = EBUSY;
+                    drain(ring);
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+private:
+    // drops unsubmitted reads and waits out the ones in flight, the buffers must not be reused under the kernel.
+    // false when the wait itself fails and requests may still land, the ring must not be used again then
+    static bool drain(Uring& ring) {
+        ring.discard_queued();
+        Uring::Completion c{};
+        while (ring.in_flight()) {
+            while (ring.reap(c)) {
+            }
+            if (!ring.in_flight()) {
+                break;
+            }
+            // a full completion queue answers EBUSY until it is reaped, which the loop above does
+            if (const int r = ring.submit(1); r < 0 && r != -EBUSY && r != -EAGAIN) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
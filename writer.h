@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <cstring>
 #include <memory>
+#include <stdexcept>
 #include <string>
 #include <thread>
 #include <filesystem>
@@ -15,6 +16,9 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include "schemas.h"
+#include "catalog.h"
+#include "checksum.h"
+#include "perf_counters.h"
 #include "../utils/spsc.h"
 
 static constexpr uint64_t HUGE_PAGE_SIZE = 2ull * 1024 * 1024;
@@ -24,6 +28,9 @@ struct WriterOpt {
     std::string product;
     static constexpr uint64_t rows_per_hr = 1ull << 24;
     uint32_t fsync_every_rows{0};
+    // every column starts on a multiple of this in the file (power of two, up to 1 GiB) so readers can map them with
+    // huge pages and read them O_DIRECT. 0 writes the old packed layout
+    uint64_t col_align{HUGE_PAGE_SIZE};
 
     WriterOpt(std::string base, std::string prod) : base_dir(std::move(base)), product(std::move(prod)) {
     }
@@ -36,6 +43,9 @@ public:
     using Header = ColFileHeaderT<Schema>;
 
     explicit WriterT(const WriterOpt& opt) : opt_(opt) {
+        if (opt_.col_align > (1ull << 30) || (opt_.col_align & (opt_.col_align - 1)) != 0) {
+            throw std::runtime_error("[writer] col_align must be 0 or a power of two up to 1 GiB");
+        }
     }
 
     ~WriterT() {
@@ -163,6 +173,7 @@ private:
             return;
         }
         ::msync(base_, HEADER_SZ, MS_SYNC);
+        const CatalogEntry entry = catalog_entry();
         ::munmap(base_, map_bytes_);
         base_ = nullptr;
         map_bytes_ = 0;
@@ -175,21 +186,58 @@ private:
         std::memset(col_off_, 0, sizeof(col_off_));
         std::memset(col_sz_, 0, sizeof(col_sz_));
         std::memset(col_ptrs_, 0, sizeof(col_ptrs_));
+
+        if (!DayCatalog::upsert(product_dir(), entry)) {
+            std::cerr << "Failed to update catalog" << std::endl;
+        }
+    }
+
+    std::string product_dir() const { return opt_.base_dir + "/" + opt_.product; }
+
+    // rows arrive in time order, first/last ts of the day file are its range
+    CatalogEntry catalog_entry() const {
+        const uint64_t n = rows_.load(std::memory_order_acquire);
+        const auto* ts = static_cast<const uint64_t*>(col_ptrs_[Schema::COL_TS]);
+        const std::string day = date_string(day_start_);
+        uint32_t crc = 0;
+        for (uint32_t c = 0; c < Schema::COLS; ++c) {
+            crc = Crc32c::compute(col_ptrs_[c], n * Schema::col_size(c), crc);
+        }
+        return DayCatalog::make_entry(static_cast<uint32_t>(std::stoul(day)), day + ".bin", CatalogCodec::COLUMNS, 0,
+                                      Schema::VERSION, n, map_bytes_, n ? ts[0] : 0, n ? ts[n - 1] : 0, crc);
     }
 
     static constexpr size_t HEADER_SZ = 256;
 
-    bool open_day_file(uint64_t day_s) {
-        capacity_ = WriterOpt::rows_per_hr * 2ull;
+    // offsets and sizes of every column for capacity rows, returns the file size
+    size_t lay_out(uint64_t capacity) {
+        const uint64_t align = opt_.col_align > 1 ? opt_.col_align : 1;
+        uint64_t off = HEADER_SZ;
+        for (uint32_t i = 0; i < Schema::COLS; ++i) {
+            off = (off + align - 1) & ~(align - 1);
+            col_off_[i] = off;
+            col_sz_[i] = capacity * Schema::col_size(i);
+            off += col_sz_[i];
+        }
+        return static_cast<size_t>((off + align - 1) & ~(align - 1));
+    }
 
-        size_t cols_bytes = 0;
+    void fill_col_header() {
+        hdr_.capacity = capacity_;
+        hdr_.layout = opt_.col_align > 1 ? COL_LAYOUT_ALIGNED : COL_LAYOUT_PACKED;
+        hdr_.col_align = opt_.col_align > 1 ? static_cast<uint32_t>(opt_.col_align) : 0;
         for (uint32_t i = 0; i < Schema::COLS; ++i) {
-            col_sz_[i] = capacity_ * Schema::col_size(i);
-            cols_bytes += col_sz_[i];
+            hdr_.col_off[i] = col_off_[i];
+            hdr_.col_sz[i] = Schema::col_size(i);
+            col_ptrs_[i] = base_ + col_off_[i];
         }
-        const size_t file_bytes = HEADER_SZ + cols_bytes;
+    }
+
+    bool open_day_file(uint64_t day_s) {
+        capacity_ = WriterOpt::rows_per_hr * 2ull;
+        const size_t file_bytes = lay_out(capacity_);
 
-        const std::string dir = opt_.base_dir + "/" + opt_.product;
+        const std::string dir = product_dir();
         if (!mkdir_p(dir)) {
             return false;
         }
@@ -223,35 +271,32 @@ private:
         std::snprintf(hdr_.product, sizeof(hdr_.product), "%s", opt_.product.c_str());
         hdr_.hour_epoch_start = day_start_;
         hdr_.rows = 0;
-        hdr_.capacity = capacity_;
-
-        uint64_t off = HEADER_SZ;
-        for (uint32_t i = 0; i < Schema::COLS; ++i) {
-            hdr_.col_off[i] = off;
-            col_off_[i] = off;
-            hdr_.col_sz[i] = Schema::col_size(i);
-            off += col_sz_[i];
-        }
+        fill_col_header();
         std::memcpy(base_, &hdr_, sizeof(hdr_));
         ::msync(base_, HEADER_SZ, MS_SYNC);
 
-        for (uint32_t i = 0; i < Schema::COLS; ++i) {
-            col_ptrs_[i] = base_ + col_off_[i];
-        }
         rows_.store(0, std::memory_order_release);
+
+        // readers plan from the catalog, the day is listed from the moment its file exists
+        const std::string day = date_string(day_s);
+        const CatalogEntry entry =
+            DayCatalog::make_entry(static_cast<uint32_t>(std::stoul(day)), day + ".bin", CatalogCodec::COLUMNS, 0,
+                                   Schema::VERSION, 0, map_bytes_, 0, 0, 0, CATALOG_DAY_OPEN);
+        if (!DayCatalog::upsert(dir, entry)) {
+            std::cerr << "Failed to update catalog" << std::endl;
+        }
         return true;
     }
 
+    // every column moves to its new offset, last column first so nothing is overwritten before it has moved
     bool grow_file() {
+        HFT_PERF_PHASE(GROW_FILE);
         const uint64_t new_capacity = capacity_ * 2ull;
         std::cout << "Growing file capacity from " << capacity_ << " to " << new_capacity << std::endl;
 
-        size_t new_cols_bytes = 0;
-        for (uint32_t i = 0; i < Schema::COLS; ++i) {
-            col_sz_[i] = new_capacity * Schema::col_size(i);
-            new_cols_bytes += col_sz_[i];
-        }
-        const size_t new_file_bytes = HEADER_SZ + new_cols_bytes;
+        uint64_t old_off[Schema::COLS];
+        std::memcpy(old_off, col_off_, sizeof(old_off));
+        const size_t new_file_bytes = lay_out(new_capacity);
 
         ::munmap(base_, map_bytes_);
         if (!preallocate(fd_, new_file_bytes)) {
@@ -266,18 +311,16 @@ private:
             return false;
         }
 
-        capacity_ = new_capacity;
-        hdr_.capacity = capacity_;
-
-        uint64_t off = HEADER_SZ;
-        for (uint32_t i = 0; i < Schema::COLS; ++i) {
-            hdr_.col_off[i] = off;
-            col_off_[i] = off;
-            hdr_.col_sz[i] = Schema::col_size(i);
-            col_ptrs_[i] = base_ + col_off_[i];
-            off += col_sz_[i];
+        // rows_ already counts the row that hit the old capacity, it is written after the move
+        const uint64_t n = capacity_;
+        for (uint32_t i = Schema::COLS; i-- > 0;) {
+            if (col_off_[i] != old_off[i]) {
+                std::memmove(base_ + col_off_[i], base_ + old_off[i], n * Schema::col_size(i));
+            }
         }
 
+        capacity_ = new_capacity;
+        fill_col_header();
         std::memcpy(base_, &hdr_, sizeof(hdr_));
         ::msync(base_, HEADER_SZ, MS_SYNC);
         return true;